@@ -0,0 +1,25 @@
+#ifndef __ADCCONVERSION_H_
+#define __ADCCONVERSION_H_
+
+#include <cstddef>
+#include <cstdint>
+
+// Converts raw words from the I2S built-in ADC (12-bit samples in the low bits) to
+// 16-bit PCM: centred on the DC offset, inverted and multiplied by the gain.
+struct AdcConversion {
+    AdcConversion(int32_t gain = 15, bool remove_dc_offset = false)
+        : gain(gain), remove_dc_offset(remove_dc_offset), dc_offset_q8(2048 << 8) {}
+
+    int32_t gain;
+    // Track the ADC's actual DC offset from block to block instead of assuming mid-scale.
+    bool remove_dc_offset;
+    // Current offset estimate, in 1/256ths of an ADC step.
+    int32_t dc_offset_q8;
+};
+
+// Converts a whole block in one pass, saturating to int16. pcm may be the same memory
+// as raw. Each block is centred on the offset estimate from the blocks before it, then
+// the estimate is updated.
+void ConvertAdcSamples(AdcConversion* conversion, const uint16_t* raw, int16_t* pcm, size_t count);
+
+#endif // __ADCCONVERSION_H_
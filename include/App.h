@@ -1,8 +1,28 @@
 #ifndef __APP_H_
 #define __APP_H_
 
+#include <cstdint>
+
 void setup_app();
+// Starts the pipeline: feature generation on core 0 and inference on core 1, connected
+// by a queue of feature slices.
+void start_app_tasks();
+// Runs both stages of the pipeline once on the calling task instead, like the host
+// replay does to stay in lock-step with the audio.
 void loop_app();
+// Switches to the model in slot (see ModelLoader.h) between two inferences, keeping the
+// window of features. Scores are averaged afresh from the new model's results. If the
+// new model can't be set up, or its input is quantized differently, the current one
+// keeps running. The running slot can't be switched to again. If even the current
+// model can't be set up again, inference stops. Returns whether it switched.
+bool switch_app_model(int slot);
+// Called with the model's raw output after every inference, from the task running it.
+typedef void (*AppScoreCallback)(int64_t time_in_ms, const int8_t* scores, int score_count);
+// Sets the callback, or clears it with nullptr. The host replay uses it to compare the
+// scores of builds with different kernels.
+void set_app_score_callback(AppScoreCallback callback);
+// Logs the per-stage timings and inference rate gathered so far.
+void report_app();
 
 
 #endif // __APP_H_
@@ -0,0 +1,52 @@
+#ifndef __AUDIOCAPTURE_H_
+#define __AUDIOCAPTURE_H_
+
+#include <cstddef>
+#include <cstdint>
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "driver/i2s.h"
+#include "AdcConversion.h"
+
+// Receives every block of captured audio, as 16-bit PCM, on the capture task.
+class AudioSink {
+public:
+    virtual ~AudioSink() {}
+    virtual void WriteSamples(const int16_t* samples, size_t count) = 0;
+};
+
+// The single I2S reader. Each DMA buffer is read once, converted from ADC words to PCM in
+// place if the built-in ADC is used, and handed to every sink. Inference, raw uploads and
+// recording to a file all share one driver and one copy of the samples.
+class AudioCapture {
+public:
+    AudioCapture(i2s_port_t port, adc_unit_t adc_unit, adc1_channel_t adc_channel,
+                 const AdcConversion& conversion = AdcConversion());
+
+    // Sinks can be added at any time, also once capture has started, but not removed.
+    bool AddSink(AudioSink* sink);
+
+    // Installs the I2S driver and starts the reader task pinned to core_id.
+    bool Start(const i2s_config_t& config, BaseType_t core_id = 0, UBaseType_t priority = 10);
+
+private:
+    static void ReaderTask(void* param);
+    void ReadAvailable();
+
+    static constexpr int kMaxSinks = 4;
+    AudioSink* _sinks[kMaxSinks];
+    volatile int _sink_count;
+
+    i2s_port_t _port;
+    adc_unit_t _adc_unit;
+    adc1_channel_t _adc_channel;
+    AdcConversion _conversion;
+    bool _is_adc_built_in;
+    QueueHandle_t _i2s_queue;
+    uint16_t* _read_buffer;
+    size_t _read_buffer_bytes;
+};
+
+
+#endif // __AUDIOCAPTURE_H_
@@ -3,11 +3,46 @@
 
 #include "tensorflow/lite/c/common.h"
 #include "tensorflow/lite/micro/micro_error_reporter.h"
+#include "AudioCapture.h"
 
+// Audio handed out in place in the capture buffer. It comes in two segments when it
+// wraps around the end of the buffer. Audio from before recording started is silence,
+// handed out as a last segment. Unused segments have a size of 0.
+constexpr int kMaxAudioSegments = 3;
+struct AudioSegments {
+    const int16_t* samples[kMaxAudioSegments];
+    int sizes[kMaxAudioSegments];
+};
+
+// Most strides of new audio GetAudioSamples() hands out at once.
+constexpr int kMaxAudioStrides = 5;
+
+// Gets the new audio for the windows from start_ms to start_ms + duration_ms, one or
+// more strides apart: everything after the first window's overlap with the stride
+// before, which the frontend keeps itself. Audio from before recording started is
+// silence. Fails if capture has already overwritten the audio, or hasn't captured all
+// of it after a short wait.
+//
+// The samples are used in place, so capture can still overwrite them. Call
+// ReleaseAudioSamples() once done, which fails if that happened.
 TfLiteStatus GetAudioSamples(tflite::ErrorReporter* error_reporter,
-                             int start_ms, int duration_ms,
-                             int* audio_samples_size, int16_t** audio_samples);
+                             int64_t start_ms, int duration_ms,
+                             AudioSegments* audio_segments);
+TfLiteStatus ReleaseAudioSamples(tflite::ErrorReporter* error_reporter);
+
+// The capture clock: samples captured since recording started, and the same in ms.
+// Both are 64-bit so they don't wrap however long the pump runs.
+uint64_t LatestAudioSampleCount();
+int64_t LatestAudioTimestamp();
+
+// Blocks the calling task until the capture clock reaches sample_count, or time_in_ms,
+// or ticks_to_wait run out. Returns whether it was reached. Capture only wakes the
+// waiter when it completes a stride, and there can only be one waiter at a time.
+bool WaitForAudioSamples(uint64_t sample_count, TickType_t ticks_to_wait);
+bool WaitForAudio(int64_t time_in_ms, TickType_t ticks_to_wait);
 
-int32_t LatestAudioTimestamp();
+// The capture engine feeding the capture buffer. Other sinks, like raw uploads or a file,
+// can be added to it to get the same audio.
+AudioCapture* GetAudioCapture();
 
 #endif // __AUDIOPROVIDER_H_
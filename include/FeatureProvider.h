@@ -3,19 +3,39 @@
 
 #include "tensorflow/lite/c/common.h"
 #include "tensorflow/lite/micro/micro_error_reporter.h"
+#include "MicroModelSettings.h"
+#include "MicroFeaturesGenerator.h"
+
+// A slice of features and the capture time it was generated at, as handed from the
+// feature stage to the inference stage.
+struct FeatureSlice {
+    int64_t time_in_ms;
+    int8_t data[kFeatureSliceSize];
+};
+
+// Generates feature slices from captured audio, one per stride.
 class FeatureProvider
 {
 public:
-    FeatureProvider(int feature_size, int8_t* feature_data);
+    // Slices are quantized for a model input with input_scale and input_zero_point.
+    FeatureProvider(float input_scale, int32_t input_zero_point);
     ~FeatureProvider();
 
-    TfLiteStatus PopulateFeatureData(tflite::ErrorReporter* error_reporter,
-                                     int32_t last_time_in_ms, int32_t time_in_ms,
-                                     int* how_many_new_slices);
+    // Works out the steps whose strides were captured between last_time_in_ms and
+    // time_in_ms: how_many_new_slices steps from first_step on. It is at most a
+    // window's worth, and a whole window the first time.
+    TfLiteStatus NewSteps(tflite::ErrorReporter* error_reporter,
+                          int64_t last_time_in_ms, int64_t time_in_ms,
+                          int64_t* first_step, int* how_many_new_slices);
+
+    // Generates the slices for slice_count steps from first_step on, at most
+    // kMaxAudioStrides, into slice_data one after the other. Steps have to be generated
+    // in order, the frontend carries state from one to the next.
+    TfLiteStatus GenerateFeatureSlices(tflite::ErrorReporter* error_reporter,
+                                       int64_t first_step, int slice_count, int8_t* slice_data);
 
 private:
-    int _feature_size;
-    int8_t* _feature_data;
+    MicroFeaturesGenerator _generator;
     bool _is_first_run;
 };
 
@@ -0,0 +1,32 @@
+#ifndef __FEATUREWINDOW_H_
+#define __FEATUREWINDOW_H_
+
+#include <cstdint>
+
+// The window of feature slices the model looks at. Slices are stored as a ring, oldest
+// first from a moving head slice, so new slices overwrite the oldest without shifting
+// the rest.
+class FeatureWindow
+{
+public:
+    FeatureWindow(int feature_size, int8_t* feature_data);
+
+    // Where the next slice goes, over the oldest one. It only becomes part of the
+    // window once committed.
+    int8_t* NextSlice() { return _feature_data + (_head_slice * _slice_size); }
+    void CommitSlice();
+
+    // Writes the window in time order to dest. If dest is the feature data itself the
+    // ring is rotated in place instead, and stays in order until the next new slice.
+    void LinearizeFeatureData(int8_t* dest);
+
+private:
+    int _feature_size;
+    int8_t* _feature_data;
+    int _slice_size;
+    int _slice_count;
+    int _head_slice;
+};
+
+
+#endif // __FEATUREWINDOW_H_
@@ -0,0 +1,26 @@
+#ifndef __FILESINK_H_
+#define __FILESINK_H_
+
+#include <cstdint>
+#include <cstdio>
+#include "AudioCapture.h"
+
+// Records captured audio as raw 16-bit PCM to a file, e.g. "/spiffs/capture.raw" on the
+// device. It writes from the capture task, so keep recordings to flash short.
+class FileSink : public AudioSink {
+public:
+    FileSink();
+    ~FileSink();
+
+    // Starts recording max_samples into path. The file is closed once they are written.
+    bool Open(const char* path, uint32_t max_samples);
+    bool IsFinished() const { return _file == nullptr; }
+
+    void WriteSamples(const int16_t* samples, size_t count) override;
+
+private:
+    FILE* volatile _file;
+    uint32_t _samples_left;
+};
+
+#endif // __FILESINK_H_
@@ -0,0 +1,54 @@
+#ifndef __INFERENCESCHEDULER_H_
+#define __INFERENCESCHEDULER_H_
+
+#include <cstdint>
+
+#include "tensorflow/lite/c/common.h"
+#include "tensorflow/lite/micro/micro_error_reporter.h"
+#include "MicroModelSettings.h"
+
+// Decides how often the model is invoked, independently of how often feature
+// slices arrive. While the latest score is within uncertainty_margin of the
+// detection threshold, or a new level was just reported, every active_stride_ms
+// of audio is scored. Otherwise the score is clearly above or below the threshold,
+// the state is considered stable and only every stable_stride_ms is scored. Above
+// the threshold, the margin is capped at half the room left up to 255, so a level
+// that is detected steadily counts as stable too.
+//
+// RecognizeLevels needs minimum_count results within its averaging window, so
+// stable_stride_ms should be no more than average_window_duration_ms / minimum_count
+// (200ms with the defaults) or it will never report a level while stable.
+class InferenceScheduler {
+public:
+    explicit InferenceScheduler(int32_t active_stride_ms = kFeatureSliceStrideMs,
+                                int32_t stable_stride_ms = 200,
+                                uint8_t uncertainty_margin = 32);
+
+    // Called with each batch of new feature slices, returns true if the model
+    // should be invoked for this batch.
+    bool ShouldInvoke(int new_slices);
+
+    // A streaming model has to see every slice to keep its state, so then every slice
+    // is scored whatever the latest results.
+    void ScoreEverySlice(bool every_slice) { _every_slice = every_slice; }
+
+    // Called with the output of RecognizeLevels after each invoke.
+    void UpdateResults(uint8_t score, uint8_t detection_threshold, bool is_new_level);
+
+    // Logs the inference rate since the previous report and starts a new count.
+    void ReportInferenceRate(tflite::ErrorReporter* error_reporter);
+
+private:
+    int _active_stride_slices;
+    int _stable_stride_slices;
+    uint8_t _uncertainty_margin;
+
+    bool _every_slice;
+    int _stride_slices;
+    int _pending_slices;
+    int32_t _reported_slices;
+    int32_t _reported_invokes;
+};
+
+
+#endif // __INFERENCESCHEDULER_H_
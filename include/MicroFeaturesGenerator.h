@@ -3,13 +3,56 @@
 
 #include "tensorflow/lite/c/common.h"
 #include "tensorflow/lite/micro/micro_error_reporter.h"
+#include "tensorflow/lite/experimental/microfrontend/lib/frontend.h"
+#include "MicroModelSettings.h"
 
-TfLiteStatus InitializeMicroFeatures(tflite::ErrorReporter* error_reporter);
+// Turns one stream of audio into feature slices. Each instance has its own frontend
+// state, so several streams can be featurized at once, e.g. one per microphone or
+// one per thread when evaluating recordings on the host.
+class MicroFeaturesGenerator
+{
+public:
+    // The frontend settings the model was trained with.
+    static FrontendConfig DefaultConfig();
 
-TfLiteStatus GenerateMicroFeatures(tflite::ErrorReporter* error_reporter,
-                                   const int16_t* input, int input_size,
-                                   int output_sze, int8_t* output,
-                                   size_t* num_samples_read);
+    // Features are quantized to the model's input, with its input_scale and
+    // input_zero_point. Those in MicroModelSettings.h use a table built at compile time,
+    // others one built by Initialize().
+    MicroFeaturesGenerator(float input_scale = kModelInputScale,
+                           int32_t input_zero_point = kModelInputZeroPoint,
+                           const FrontendConfig& config = DefaultConfig());
+    ~MicroFeaturesGenerator();
+
+    // Sets up the frontend state and the feature table, or resets the state to the
+    // start of a new stream.
+    TfLiteStatus Initialize(tflite::ErrorReporter* error_reporter);
+
+    // Feeds any amount of new audio to the frontend, which keeps each window's overlap
+    // with the previous stride itself. A slice of kFeatureSliceSize features is written
+    // to output for every stride completed, so a burst of several strides gives as many
+    // slices and part of a stride none until the rest arrives. Fails rather than write
+    // more than max_slices.
+    TfLiteStatus Generate(tflite::ErrorReporter* error_reporter,
+                          const int16_t* input, int input_size,
+                          int max_slices, int8_t* output,
+                          int* slices_written);
+
+private:
+    // The frontend state owns allocations, so it can't be copied.
+    MicroFeaturesGenerator(const MicroFeaturesGenerator&);
+    MicroFeaturesGenerator& operator=(const MicroFeaturesGenerator&);
+
+    TfLiteStatus BuildFeatureTable(tflite::ErrorReporter* error_reporter);
+
+    FrontendConfig _config;
+    FrontendState _state;
+    bool _is_initialized;
+    float _input_scale;
+    int32_t _input_zero_point;
+    const int8_t* _table;
+    int _table_size;
+    int8_t* _runtime_table;
+};
 
 
 #endif // __MICROFEATURESGENERATOR_H_
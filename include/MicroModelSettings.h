@@ -1,7 +1,6 @@
 #ifndef __MICROMODELSETTINGS_H_
 #define __MICROMODELSETTINGS_H_
 
-constexpr int kMaxAudioSampleSize = 512;
 constexpr int kAudioSampleFrequency = 16000;
 
 constexpr int kFeatureSliceSize = 40;
@@ -9,6 +8,18 @@ constexpr int kFeatureSliceCount = 49;
 constexpr int kFeatureElementCount = (kFeatureSliceSize * kFeatureSliceCount);
 constexpr int kFeatureSliceStrideMs = 20;
 constexpr int kFeatureSliceDurationMs = 30;
+// New samples per slice, and the samples each slice's window shares with the previous one.
+constexpr int kFeatureSliceStrideSamples = kFeatureSliceStrideMs * (kAudioSampleFrequency / 1000);
+constexpr int kFeatureSliceHistorySamples =
+    (kFeatureSliceDurationMs - kFeatureSliceStrideMs) * (kAudioSampleFrequency / 1000);
+
+// Features go into the model the way training scaled them: the frontend output divided
+// by kFeatureInputDivisor, then quantized with the model input's scale and zero point.
+// The input quantization is copied from the converted model. A model converted with
+// other values still works, its table is just built at runtime instead.
+constexpr float kFeatureInputDivisor = 25.6f;
+constexpr float kModelInputScale = 0.1018688753f;
+constexpr int kModelInputZeroPoint = -128;
 
 enum PowerLevel {
 NONE,
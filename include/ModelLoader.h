@@ -0,0 +1,31 @@
+#ifndef __MODELLOADER_H_
+#define __MODELLOADER_H_
+
+#include <cstddef>
+#include <cstdint>
+
+#include "tensorflow/lite/micro/micro_error_reporter.h"
+
+// Models can be written to one of two slots, data partitions in custom.csv, instead of
+// being built into the firmware, e.g. with `parttool.py write_partition --partition-name
+// model0`, and switched between at runtime. The built-in model is the fallback slot.
+constexpr int kModelSlotCount = 2;
+constexpr int kBuiltInModelSlot = -1;
+constexpr int kModelPartitionSubtype = 0x40;
+extern const char* const kModelPartitionLabels[kModelSlotCount];
+
+// Checks that data holds a TFLite flatbuffer of the supported schema version, which
+// fits in size bytes, before anything is read through it.
+bool IsValidModel(tflite::ErrorReporter* error_reporter, const uint8_t* data, size_t size);
+
+// Maps the model in slot, or the built-in one for kBuiltInModelSlot, to run it in place
+// in flash. Returns nullptr if the slot doesn't hold a valid model, or is still loaded.
+const uint8_t* LoadModelSlot(tflite::ErrorReporter* error_reporter, int slot, size_t* model_size);
+// Releases a slot's mapping once its model isn't used any more.
+void UnloadModelSlot(int slot);
+
+// Finds the model to start with: the first slot holding a valid model, otherwise the
+// built-in one. Returns nullptr if none is valid.
+const uint8_t* LoadModel(tflite::ErrorReporter* error_reporter, int* slot, size_t* model_size);
+
+#endif // __MODELLOADER_H_
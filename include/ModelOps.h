@@ -0,0 +1,68 @@
+#ifndef __MODELOPS_H_
+#define __MODELOPS_H_
+
+#include "tensorflow/lite/micro/micro_mutable_op_resolver.h"
+#ifdef MODEL_INT8_KERNELS
+#include "tensorflow/lite/micro/kernels/depthwise_conv.h"
+#include "tensorflow/lite/micro/kernels/fully_connected.h"
+#include "tensorflow/lite/micro/kernels/conv.h"
+#endif
+
+// Written by python/model_ops.py from src/model.cpp, the build regenerates it
+// when the model changes. Registers exactly the ops the model uses, shared by
+// the firmware and the host tools. With MODEL_INT8_KERNELS the int8-only
+// kernels are used where there are any. With MODEL_STREAMING_OPS the ones a
+// streaming model needs are added.
+#ifdef MODEL_STREAMING_OPS
+constexpr int kModelOpCount = 9;
+#else
+constexpr int kModelOpCount = 4;
+#endif
+typedef tflite::MicroMutableOpResolver<kModelOpCount> ModelOpResolver;
+
+inline TfLiteStatus AddModelOps(ModelOpResolver* resolver) {
+#ifdef MODEL_INT8_KERNELS
+    if (resolver->AddDepthwiseConv2D(tflite::Register_DEPTHWISE_CONV_2D_INT8()) != kTfLiteOk) {
+#else
+    if (resolver->AddDepthwiseConv2D() != kTfLiteOk) {
+#endif
+        return kTfLiteError;
+    }
+#ifdef MODEL_INT8_KERNELS
+    if (resolver->AddFullyConnected(tflite::Register_FULLY_CONNECTED_INT8()) != kTfLiteOk) {
+#else
+    if (resolver->AddFullyConnected() != kTfLiteOk) {
+#endif
+        return kTfLiteError;
+    }
+    if (resolver->AddReshape() != kTfLiteOk) {
+        return kTfLiteError;
+    }
+    if (resolver->AddSoftmax() != kTfLiteOk) {
+        return kTfLiteError;
+    }
+#ifdef MODEL_STREAMING_OPS
+    if (resolver->AddConcatenation() != kTfLiteOk) {
+        return kTfLiteError;
+    }
+#ifdef MODEL_INT8_KERNELS
+    if (resolver->AddConv2D(tflite::Register_CONV_2D_INT8()) != kTfLiteOk) {
+#else
+    if (resolver->AddConv2D() != kTfLiteOk) {
+#endif
+        return kTfLiteError;
+    }
+    if (resolver->AddPad() != kTfLiteOk) {
+        return kTfLiteError;
+    }
+    if (resolver->AddQuantize() != kTfLiteOk) {
+        return kTfLiteError;
+    }
+    if (resolver->AddStridedSlice() != kTfLiteOk) {
+        return kTfLiteError;
+    }
+#endif
+    return kTfLiteOk;
+}
+
+#endif // __MODELOPS_H_
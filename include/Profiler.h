@@ -0,0 +1,59 @@
+#ifndef __PROFILER_H_
+#define __PROFILER_H_
+
+#include <cstdint>
+
+#if !defined(__XTENSA__)
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#else
+#include <time.h>
+#endif
+#endif
+
+#include "tensorflow/lite/micro/micro_error_reporter.h"
+
+// Stages of the pipeline that are timed. Audio fetch and feature generation are
+// recorded per fetch of audio from inside FeatureProvider.
+enum ProfileStage {
+    kProfileAudioFetch,
+    kProfileFeatureGeneration,
+    kProfileFeatureCopy,
+    kProfileInvoke,
+    kProfilePostProcess,
+    kProfileStageCount,
+};
+
+// Bucket n counts durations in [2^n, 2^(n+1)) ticks.
+constexpr int kProfileHistogramBuckets = 32;
+
+struct StageProfile {
+    uint32_t count;
+    uint32_t min;
+    uint32_t max;
+    uint64_t total;
+    uint32_t histogram[kProfileHistogramBuckets];
+};
+
+// Ticks are CPU cycles on the device and on x86 hosts, nanoseconds elsewhere.
+// Only differences between two readings are meaningful.
+inline uint32_t ProfileNow() {
+#if defined(__XTENSA__)
+    uint32_t ccount;
+    __asm__ __volatile__("rsr %0, ccount" : "=a"(ccount));
+    return ccount;
+#elif defined(__x86_64__) || defined(__i386__)
+    return static_cast<uint32_t>(__rdtsc());
+#else
+    timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return static_cast<uint32_t>(now.tv_sec * 1000000000ull + now.tv_nsec);
+#endif
+}
+
+void ProfileRecord(ProfileStage stage, uint32_t start_ticks);
+const StageProfile& GetStageProfile(ProfileStage stage);
+void ResetStageProfiles();
+void ReportStageProfiles(tflite::ErrorReporter* error_reporter);
+
+#endif // __PROFILER_H_
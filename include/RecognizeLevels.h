@@ -7,21 +7,28 @@
 #include "MicroModelSettings.h"
 #include "tensorflow/lite/micro/micro_error_reporter.h"
 
+// The results within the averaging window, oldest first, with running per-category
+// sums of their scores so averaging doesn't depend on the window's length.
 class PreviousResultsQueue {
  public:
-  PreviousResultsQueue(tflite::ErrorReporter* error_reporter)
-      : error_reporter_(error_reporter), front_index_(0), size_(0) {}
+  // Holds up to max_results, the oldest are dropped to make room beyond that.
+  PreviousResultsQueue(tflite::ErrorReporter* error_reporter, int max_results)
+      : error_reporter_(error_reporter), max_results_(max_results),
+        results_(new Result[max_results]), front_index_(0), size_(0), sums_() {}
+  ~PreviousResultsQueue() { delete[] results_; }
+  PreviousResultsQueue(const PreviousResultsQueue&) = delete;
+  PreviousResultsQueue& operator=(const PreviousResultsQueue&) = delete;
 
   // Data structure that holds an inference result, and the time when it
   // was recorded.
   struct Result {
     Result() : time_(0), scores() {}
-    Result(int32_t time, int8_t* input_scores) : time_(time) {
+    Result(int64_t time, int8_t* input_scores) : time_(time) {
       for (int i = 0; i < kCategoryCount; ++i) {
         scores[i] = input_scores[i];
       }
     }
-    int32_t time_;
+    int64_t time_;
     int8_t scores[kCategoryCount];
   };
 
@@ -30,21 +37,26 @@ class PreviousResultsQueue {
   Result& front() { return results_[front_index_]; }
   Result& back() {
     int back_index = front_index_ + (size_ - 1);
-    if (back_index >= kMaxResults) {
-      back_index -= kMaxResults;
+    if (back_index >= max_results_) {
+      back_index -= max_results_;
     }
     return results_[back_index];
   }
+  // The sum of each category's scores over the results held.
+  const int32_t* sums() const { return sums_; }
 
   void push_back(const Result& entry) {
-    if (size() >= kMaxResults) {
-      TF_LITE_REPORT_ERROR(
-          error_reporter_,
-          "Couldn't push_back latest result, too many already!");
-      return;
+    if (size() >= max_results_) {
+      // Results are coming in faster than the window was sized for.
+      TF_LITE_REPORT_ERROR(error_reporter_,
+                           "Results queue is full, dropping the oldest result");
+      pop_front();
     }
     size_ += 1;
     back() = entry;
+    for (int i = 0; i < kCategoryCount; ++i) {
+      sums_[i] += entry.scores[i];
+    }
   }
 
   Result pop_front() {
@@ -55,13 +67,24 @@ class PreviousResultsQueue {
     }
     Result result = front();
     front_index_ += 1;
-    if (front_index_ >= kMaxResults) {
+    if (front_index_ >= max_results_) {
       front_index_ = 0;
     }
     size_ -= 1;
+    for (int i = 0; i < kCategoryCount; ++i) {
+      sums_[i] -= result.scores[i];
+    }
     return result;
   }
 
+  void clear() {
+    front_index_ = 0;
+    size_ = 0;
+    for (int i = 0; i < kCategoryCount; ++i) {
+      sums_[i] = 0;
+    }
+  }
+
   // Most of the functions are duplicates of dequeue containers, but this
   // is a helper that makes it easy to iterate through the contents of the
   // queue.
@@ -72,22 +95,29 @@ class PreviousResultsQueue {
       offset = size_ - 1;
     }
     int index = front_index_ + offset;
-    if (index >= kMaxResults) {
-      index -= kMaxResults;
+    if (index >= max_results_) {
+      index -= max_results_;
     }
     return results_[index];
   }
 
  private:
   tflite::ErrorReporter* error_reporter_;
-  static constexpr int kMaxResults = 50;
-  Result results_[kMaxResults];
+  int max_results_;
+  Result* results_;
 
   int front_index_;
   int size_;
+  int32_t sums_[kCategoryCount];
 };
 
 
+// Averages the model's scores over a window and picks the level they point to. The
+// model's output can be its softmax, or its logits when exported without the Softmax
+// (see python/keyword-spotting.py logits), which are averaged and thresholded on the
+// top level's margin over the runner-up with integer math instead. Their score is
+// the softmax of the averaged logits when a new level is reported, otherwise the
+// softmax of just the top two, which is what the threshold applies to.
 class RecognizeLevels {
 public:
     explicit RecognizeLevels(tflite::ErrorReporter* error_reporter,
@@ -97,12 +127,24 @@ public:
                              int32_t minimum_count = 5);
 
     TfLiteStatus ProcessLatestResults(const TfLiteTensor* latest_results,
-                                      const int32_t current_time_ms,
+                                      const int64_t current_time_ms,
                                       PowerLevel* level,
                                       uint8_t* score,
                                       bool* is_new_level);
 
+    // Forgets the results so far and the last level reported. Call it when the model
+    // changes, as its results can't be averaged with the previous model's, which may
+    // not even be in the same domain (softmax or logits).
+    void Reset();
+
+    uint8_t DetectionThreshold() const { return _detection_threshold; }
+
 private:
+    // A difference of logits summed over count results, averaged, in kExpTable steps.
+    int64_t LogitSteps(int32_t logit_sum_difference, int count, float scale);
+    // The 0-255 score of top_index from the logits summed over count results.
+    int32_t LogitsScore(const int32_t* logit_sums, int top_index, int count, float scale);
+
     tflite::ErrorReporter* _error_reporter;
     int32_t _average_window_duration_ms;
     uint8_t _detection_threshold;
@@ -111,7 +153,12 @@ private:
 
     PreviousResultsQueue _previous_results;
     PowerLevel _previous_top_label;
-    int32_t _previous_top_label_time;
+    int64_t _previous_top_label_time;
+    // Output scale the multiplier was worked out for, it changes with the model.
+    float _logits_scale;
+    int64_t _logits_multiplier;
+    // For logits, the margin in kExpTable steps the top level needs over the runner-up.
+    int32_t _threshold_steps;
 };
 
 
@@ -1,8 +1,9 @@
 #ifndef __RINGBUFFER_H_
 #define __RINGBUFFER_H_
 
+#include <esp_err.h>
 #include <freertos/FreeRTOS.h>
-#include <freertos/semphr.h>
+#include <freertos/task.h>
 #include <stdint.h>
 
 #ifdef __cplusplus
@@ -13,27 +14,38 @@ extern "C" {
 #define RB_ABORT -1
 #define RB_WRITER_FINISHED -2
 #define RB_READER_UNBLOCK -3
+#define RB_OVERWRITTEN -4
 
+    /*
+     * Single producer, single consumer ring buffer. The writer only moves head and
+     * the reader only moves tail, so neither side takes a lock. Both are free running
+     * byte counts, masked into the power of two sized buffer.
+     *
+     * A side that has to wait (ticks_to_wait > 0) registers its task and sleeps on
+     * its task notification until the other side makes progress.
+     */
     typedef struct ringbuf {
         char* name;
         uint8_t* base;
-        uint8_t* volatile readptr;
-        uint8_t* volatile writeptr;
-        volatile ssize_t fill_cnt;
-        ssize_t size;
-        xSemaphoreHandle can_read;
-        xSemaphoreHandle can_write;
-        xSemaphoreHandle lock;
-        int abort_read;
-        int abort_write;
-        int writer_finished;
-        int reader_unblock;
+        uint32_t size;
+        uint32_t mask;
+        volatile uint32_t head;
+        volatile uint32_t tail;
+        volatile uint32_t write_reserve;
+        TaskHandle_t volatile waiting_reader;
+        TaskHandle_t volatile waiting_writer;
+        volatile int abort_read;
+        volatile int abort_write;
+        volatile int writer_finished;
+        volatile int reader_unblock;
     } ringbuf_t;
 
+    // The size is rounded up to a power of two.
     ringbuf_t* rb_init(const char* rb_name, uint32_t size);
     void rb_abort_read(ringbuf_t* rb);
     void rb_abort_write(ringbuf_t* rb);
     void rb_abort(ringbuf_t* rb);
+    // Resets are not synchronised with rb_read/rb_write, only use them while both sides are idle.
     void rb_reset(ringbuf_t* rb);
     void rb_reset_and_abort_write(ringbuf_t* rb);
     void rb_stat(ringbuf_t* rb);
@@ -42,6 +54,34 @@ extern "C" {
     int rb_read(ringbuf_t* rb, uint8_t* buf, int len, uint32_t ticks_to_wait);
     int rb_write(ringbuf_t* rb, const uint8_t* buf, int len,
                  uint32_t ticks_to_wait);
+    /*
+     * Zero-copy read: waits like rb_read until len bytes are filled, then points at
+     * up to len of them in place. The data comes back as two segments when it wraps
+     * around the end of the buffer, otherwise len2 is 0. Returns the total peeked,
+     * or a negative RB_* code. Nothing is consumed until rb_commit_read, and the
+     * writer can't overwrite the peeked bytes before then. rb_commit_read returns
+     * len, or RB_FAIL without consuming anything if len is more than is filled.
+     */
+    int rb_peek(ringbuf_t* rb, uint8_t** ptr1, int* len1, uint8_t** ptr2, int* len2,
+                int len, uint32_t ticks_to_wait);
+    int rb_commit_read(ringbuf_t* rb, int len);
+
+    /*
+     * Capture style access, used instead of the calls above. The writer never waits
+     * and overwrites the oldest data, and the reader addresses the data by absolute
+     * byte position (the free running head count) rather than consuming it.
+     *
+     * rb_peek_at waits until len bytes from position have been written, then points
+     * at what is there in place, as two segments when it wraps. It returns the bytes
+     * available, or RB_OVERWRITTEN if any of them have been overwritten already.
+     * The writer may still overwrite them while they are in use, so check with
+     * rb_is_intact once done before trusting the result.
+     */
+    int rb_write_overwrite(ringbuf_t* rb, const uint8_t* buf, int len);
+    uint32_t rb_write_position(ringbuf_t* rb);
+    int rb_peek_at(ringbuf_t* rb, uint32_t position, uint8_t** ptr1, int* len1,
+                   uint8_t** ptr2, int* len2, int len, uint32_t ticks_to_wait);
+    int rb_is_intact(ringbuf_t* rb, uint32_t position);
     void rb_cleanup(ringbuf_t* rb);
     void rb_signal_writer_finished(ringbuf_t* rb);
     void rb_wakeup_reader(ringbuf_t* rb);
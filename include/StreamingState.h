@@ -0,0 +1,54 @@
+#ifndef __STREAMINGSTATE_H_
+#define __STREAMINGSTATE_H_
+
+#include <cstddef>
+#include <cstdint>
+
+#include "tensorflow/lite/c/common.h"
+#include "tensorflow/lite/micro/micro_error_reporter.h"
+#include "tensorflow/lite/micro/micro_interpreter.h"
+
+// The state a streaming model carries from one Invoke() to the next. A model exported
+// with external state takes it as extra inputs and returns the next state as extra
+// outputs of the same shape, which are copied back over the inputs after every
+// Invoke(). A model keeping its state in variable tensors has no extra inputs, and
+// nothing to copy.
+class StreamingState
+{
+public:
+    StreamingState();
+    ~StreamingState();
+
+    // Pairs every input except feature_input with the output of the same size and
+    // quantization, other than score_output. Clears the state.
+    TfLiteStatus Initialize(tflite::ErrorReporter* error_reporter,
+                            tflite::MicroInterpreter* interpreter,
+                            int feature_input, int score_output);
+    // The same for the model's input and output tensors given directly.
+    TfLiteStatus Initialize(tflite::ErrorReporter* error_reporter,
+                            TfLiteTensor* const* inputs, int input_count,
+                            const TfLiteTensor* const* outputs, int output_count,
+                            int feature_input, int score_output);
+
+    // Starts again from the state of silence before any features.
+    void Reset();
+    // Copies the state returned by the last Invoke() to where the next one reads it.
+    void Carry();
+
+    int StateCount() const { return _state_count; }
+    bool IsStaged() const { return _staging != nullptr; }
+
+private:
+    static constexpr int kMaxStates = 4;
+
+    TfLiteTensor* _state_inputs[kMaxStates];
+    const TfLiteTensor* _state_outputs[kMaxStates];
+    int _state_count;
+    // Only needed when the arena places an output over another state's input, which
+    // would be overwritten before it is copied.
+    int8_t* _staging;
+    size_t _staging_size;
+};
+
+
+#endif // __STREAMINGSTATE_H_
@@ -0,0 +1,13 @@
+#ifndef __TENSORARENASIZE_H_
+#define __TENSORARENASIZE_H_
+
+// Placeholder until the arena_size tool (src/host/tools/ArenaSize.cpp) is run against
+// TFLM for the model in src/model.cpp, which overwrites this file, see README.
+
+// Not measured: the arena size the firmware used before the tool existed.
+constexpr int kTensorArenaSize = 10240;
+// g_model_len of the model it was measured for, 0 as it hasn't been. setup_app()
+// warns until the tool has written a real one, and if the model changes after.
+constexpr int kTensorArenaModelLen = 0;
+
+#endif // __TENSORARENASIZE_H_
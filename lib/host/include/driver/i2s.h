@@ -0,0 +1,113 @@
+#ifndef __HOST_DRIVER_I2S_H_
+#define __HOST_DRIVER_I2S_H_
+
+// Host stand-in for the ESP32 I2S driver. Instead of the ADC, i2s_read() hands
+// out samples from a replay source, one chunk per i2s_host_advance() call, so
+// the capture task runs in lock-step with whoever drives the replay. In built-in
+// ADC mode the PCM is handed out as the 12-bit ADC words that would produce it.
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "esp_err.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/queue.h"
+
+#define ESP_INTR_FLAG_LEVEL1 (1 << 1)
+
+typedef enum {
+    I2S_NUM_0 = 0,
+    I2S_NUM_1 = 1,
+} i2s_port_t;
+
+typedef enum {
+    I2S_MODE_MASTER = 1,
+    I2S_MODE_SLAVE = 2,
+    I2S_MODE_TX = 4,
+    I2S_MODE_RX = 8,
+    I2S_MODE_DAC_BUILT_IN = 16,
+    I2S_MODE_ADC_BUILT_IN = 32,
+} i2s_mode_t;
+
+typedef enum {
+    I2S_BITS_PER_SAMPLE_8BIT = 8,
+    I2S_BITS_PER_SAMPLE_16BIT = 16,
+    I2S_BITS_PER_SAMPLE_24BIT = 24,
+    I2S_BITS_PER_SAMPLE_32BIT = 32,
+} i2s_bits_per_sample_t;
+
+typedef enum {
+    I2S_CHANNEL_FMT_RIGHT_LEFT = 0,
+    I2S_CHANNEL_FMT_ALL_RIGHT,
+    I2S_CHANNEL_FMT_ALL_LEFT,
+    I2S_CHANNEL_FMT_ONLY_RIGHT,
+    I2S_CHANNEL_FMT_ONLY_LEFT,
+} i2s_channel_fmt_t;
+
+typedef enum {
+    I2S_COMM_FORMAT_I2S = 0x01,
+    I2S_COMM_FORMAT_I2S_MSB = 0x02,
+    I2S_COMM_FORMAT_I2S_LSB = 0x04,
+} i2s_comm_format_t;
+
+typedef enum {
+    I2S_EVENT_DMA_ERROR = 0,
+    I2S_EVENT_TX_DONE,
+    I2S_EVENT_RX_DONE,
+    I2S_EVENT_MAX,
+} i2s_event_type_t;
+
+typedef struct {
+    i2s_event_type_t type;
+    size_t size;
+} i2s_event_t;
+
+typedef struct {
+    i2s_mode_t mode;
+    int sample_rate;
+    i2s_bits_per_sample_t bits_per_sample;
+    i2s_channel_fmt_t channel_format;
+    i2s_comm_format_t communication_format;
+    int intr_alloc_flags;
+    int dma_buf_count;
+    int dma_buf_len;
+    bool use_apll;
+    bool tx_desc_auto_clear;
+    int fixed_mclk;
+} i2s_config_t;
+
+typedef enum {
+    ADC_UNIT_1 = 1,
+    ADC_UNIT_2 = 2,
+} adc_unit_t;
+
+typedef enum {
+    ADC1_CHANNEL_0 = 0,
+    ADC1_CHANNEL_1,
+    ADC1_CHANNEL_2,
+    ADC1_CHANNEL_3,
+    ADC1_CHANNEL_4,
+    ADC1_CHANNEL_5,
+    ADC1_CHANNEL_6,
+    ADC1_CHANNEL_7,
+} adc1_channel_t;
+
+esp_err_t i2s_driver_install(i2s_port_t port, const i2s_config_t* config,
+                             int queue_size, QueueHandle_t* queue);
+esp_err_t i2s_driver_uninstall(i2s_port_t port);
+esp_err_t i2s_set_adc_mode(adc_unit_t adc_unit, adc1_channel_t adc_channel);
+esp_err_t i2s_adc_enable(i2s_port_t port);
+esp_err_t i2s_zero_dma_buffer(i2s_port_t port);
+// Never blocks on the host, returns whatever the replay has released so far.
+esp_err_t i2s_read(i2s_port_t port, void* dest, size_t size, size_t* bytes_read,
+                   TickType_t ticks_to_wait);
+
+// Host only: set the 16-bit PCM samples to replay. Installing the driver
+// releases the first chunk straight away, like the first DMA buffer filling.
+void i2s_host_set_source(const int16_t* samples, size_t sample_count, size_t chunk_samples);
+// Host only: wait for the reader to consume the previous chunk and go back to
+// waiting for events, then release the next one. Returns false once the
+// source is exhausted.
+bool i2s_host_advance();
+
+#endif // __HOST_DRIVER_I2S_H_
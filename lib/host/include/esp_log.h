@@ -0,0 +1,24 @@
+#ifndef __HOST_ESP_LOG_H_
+#define __HOST_ESP_LOG_H_
+
+#include <stdio.h>
+
+// Levels match esp_log_level_t, anything above HOST_LOG_LEVEL is compiled out.
+#ifndef HOST_LOG_LEVEL
+#define HOST_LOG_LEVEL 3
+#endif
+
+#define HOST_LOG(level, letter, tag, format, ...)                                  \
+    do {                                                                           \
+        if ((level) <= HOST_LOG_LEVEL) {                                           \
+            fprintf(stderr, letter " (%s) " format "\n", tag, ##__VA_ARGS__);       \
+        }                                                                          \
+    } while (0)
+
+#define ESP_LOGE(tag, format, ...) HOST_LOG(1, "E", tag, format, ##__VA_ARGS__)
+#define ESP_LOGW(tag, format, ...) HOST_LOG(2, "W", tag, format, ##__VA_ARGS__)
+#define ESP_LOGI(tag, format, ...) HOST_LOG(3, "I", tag, format, ##__VA_ARGS__)
+#define ESP_LOGD(tag, format, ...) HOST_LOG(4, "D", tag, format, ##__VA_ARGS__)
+#define ESP_LOGV(tag, format, ...) HOST_LOG(5, "V", tag, format, ##__VA_ARGS__)
+
+#endif // __HOST_ESP_LOG_H_
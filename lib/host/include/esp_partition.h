@@ -0,0 +1,49 @@
+#ifndef __HOST_ESP_PARTITION_H_
+#define __HOST_ESP_PARTITION_H_
+
+// Host stand-in for the ESP32 partition API. There is no flash, data partitions are
+// whatever buffers have been registered with esp_partition_host_add(), and mapping
+// one just points at its buffer.
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "esp_err.h"
+
+typedef enum {
+    ESP_PARTITION_TYPE_APP = 0x00,
+    ESP_PARTITION_TYPE_DATA = 0x01,
+} esp_partition_type_t;
+
+typedef int esp_partition_subtype_t;
+#define ESP_PARTITION_SUBTYPE_ANY 0xff
+
+typedef enum {
+    SPI_FLASH_MMAP_DATA,
+    SPI_FLASH_MMAP_INST,
+} spi_flash_mmap_memory_t;
+
+typedef uint32_t spi_flash_mmap_handle_t;
+
+typedef struct {
+    esp_partition_type_t type;
+    esp_partition_subtype_t subtype;
+    uint32_t address;
+    uint32_t size;
+    char label[17];
+    bool encrypted;
+} esp_partition_t;
+
+const esp_partition_t* esp_partition_find_first(esp_partition_type_t type,
+                                                esp_partition_subtype_t subtype,
+                                                const char* label);
+esp_err_t esp_partition_mmap(const esp_partition_t* partition, size_t offset, size_t size,
+                             spi_flash_mmap_memory_t memory, const void** out_ptr,
+                             spi_flash_mmap_handle_t* out_handle);
+void spi_flash_munmap(spi_flash_mmap_handle_t handle);
+
+// Host only: adds a data partition holding size bytes of data, which has to outlive it.
+void esp_partition_host_add(esp_partition_subtype_t subtype, const char* label,
+                            const uint8_t* data, uint32_t size);
+
+#endif // __HOST_ESP_PARTITION_H_
@@ -0,0 +1,6 @@
+#ifndef __HOST_ESP_SYSTEM_H_
+#define __HOST_ESP_SYSTEM_H_
+
+// Nothing from this header is used by the host build, it only has to exist.
+
+#endif // __HOST_ESP_SYSTEM_H_
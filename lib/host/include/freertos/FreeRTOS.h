@@ -0,0 +1,31 @@
+#ifndef __HOST_FREERTOS_H_
+#define __HOST_FREERTOS_H_
+
+// Host stand-in for the subset of FreeRTOS used by the firmware. Tasks run as
+// std::threads and ticks are milliseconds of wall clock time.
+
+#include <assert.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/types.h>
+
+typedef int BaseType_t;
+typedef unsigned int UBaseType_t;
+typedef uint32_t TickType_t;
+
+#define pdFALSE 0
+#define pdTRUE 1
+#define pdPASS pdTRUE
+#define pdFAIL pdFALSE
+
+#define portMAX_DELAY ((TickType_t) 0xffffffffUL)
+#define portTICK_PERIOD_MS 1
+#define configTICK_RATE_HZ 1000
+#define pdMS_TO_TICKS(ms) ((TickType_t) (ms) / portTICK_PERIOD_MS)
+
+struct HostTask;
+struct HostQueue;
+typedef HostTask* TaskHandle_t;
+typedef HostQueue* QueueHandle_t;
+
+#endif // __HOST_FREERTOS_H_
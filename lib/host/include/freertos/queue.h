@@ -0,0 +1,16 @@
+#ifndef __HOST_FREERTOS_QUEUE_H_
+#define __HOST_FREERTOS_QUEUE_H_
+
+#include "freertos/FreeRTOS.h"
+
+QueueHandle_t xQueueCreate(UBaseType_t length, UBaseType_t item_size);
+void vQueueDelete(QueueHandle_t queue);
+BaseType_t xQueueSend(QueueHandle_t queue, const void* item, TickType_t ticks_to_wait);
+BaseType_t xQueueReceive(QueueHandle_t queue, void* item, TickType_t ticks_to_wait);
+UBaseType_t uxQueueMessagesWaiting(QueueHandle_t queue);
+
+// Host only: block until the queue is empty and a task is blocked receiving from it.
+// Lets a replay driver step a consumer task in lock-step with the data it feeds.
+void vQueueHostWaitForReceiver(QueueHandle_t queue);
+
+#endif // __HOST_FREERTOS_QUEUE_H_
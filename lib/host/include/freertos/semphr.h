@@ -0,0 +1,27 @@
+#ifndef __HOST_FREERTOS_SEMPHR_H_
+#define __HOST_FREERTOS_SEMPHR_H_
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/queue.h"
+
+// As in FreeRTOS, semaphores are queues of zero sized items.
+typedef QueueHandle_t SemaphoreHandle_t;
+typedef QueueHandle_t xSemaphoreHandle;
+
+#define xSemaphoreCreateBinary() xQueueCreate(1, 0)
+#define vSemaphoreCreateBinary(sem)         \
+    do {                                    \
+        (sem) = xQueueCreate(1, 0);         \
+        if ((sem) != NULL) {                \
+            xQueueSend((sem), NULL, 0);     \
+        }                                   \
+    } while (0)
+// No priority inheritance on the host, a mutex is a binary semaphore that starts given.
+#define xSemaphoreCreateMutex() xQueueHostCreateGiven()
+#define xSemaphoreTake(sem, ticks) xQueueReceive((sem), NULL, (ticks))
+#define xSemaphoreGive(sem) xQueueSend((sem), NULL, 0)
+#define vSemaphoreDelete(sem) vQueueDelete(sem)
+
+QueueHandle_t xQueueHostCreateGiven();
+
+#endif // __HOST_FREERTOS_SEMPHR_H_
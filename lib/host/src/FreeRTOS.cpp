@@ -0,0 +1,182 @@
+#include "freertos/FreeRTOS.h"
+#include "freertos/queue.h"
+#include "freertos/semphr.h"
+#include "freertos/task.h"
+
+#include <chrono>
+#include <condition_variable>
+#include <cstring>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+struct HostTask {
+    std::mutex lock;
+    std::condition_variable notified;
+    uint32_t notify_value = 0;
+};
+
+struct HostQueue {
+    HostQueue(UBaseType_t queue_length, UBaseType_t queue_item_size)
+        : length(queue_length), item_size(queue_item_size) {}
+
+    std::mutex lock;
+    std::condition_variable can_receive;
+    std::condition_variable can_send;
+    std::condition_variable receiver_waiting;
+    std::deque<std::vector<uint8_t>> items;
+    UBaseType_t length;
+    UBaseType_t item_size;
+    int waiting_receivers = 0;
+};
+
+namespace {
+    thread_local HostTask* g_current_task = nullptr;
+    const auto g_start_time = std::chrono::steady_clock::now();
+
+    template <typename Predicate>
+    bool WaitTicks(std::condition_variable& condition, std::unique_lock<std::mutex>& lock,
+                   TickType_t ticks_to_wait, Predicate predicate) {
+        if (ticks_to_wait == portMAX_DELAY) {
+            condition.wait(lock, predicate);
+            return true;
+        }
+        return condition.wait_for(lock, std::chrono::milliseconds(ticks_to_wait * portTICK_PERIOD_MS),
+                                  predicate);
+    }
+}
+
+BaseType_t xTaskCreate(TaskFunction_t task, const char* name, uint32_t stack_depth,
+                       void* param, UBaseType_t priority, TaskHandle_t* created_task) {
+    HostTask* host_task = new HostTask();
+    if (created_task) {
+        *created_task = host_task;
+    }
+    std::thread([task, param, host_task]() {
+        g_current_task = host_task;
+        task(param);
+    }).detach();
+    return pdPASS;
+}
+
+BaseType_t xTaskCreatePinnedToCore(TaskFunction_t task, const char* name, uint32_t stack_depth,
+                                   void* param, UBaseType_t priority, TaskHandle_t* created_task,
+                                   BaseType_t core_id) {
+    return xTaskCreate(task, name, stack_depth, param, priority, created_task);
+}
+
+void vTaskDelete(TaskHandle_t task) {}
+
+void vTaskDelay(TickType_t ticks) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(ticks * portTICK_PERIOD_MS));
+}
+
+TickType_t xTaskGetTickCount() {
+    return std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::steady_clock::now() - g_start_time).count() / portTICK_PERIOD_MS;
+}
+
+TaskHandle_t xTaskGetCurrentTaskHandle() {
+    // Threads not started through xTaskCreate (e.g. main) get a handle on first use.
+    if (!g_current_task) {
+        g_current_task = new HostTask();
+    }
+    return g_current_task;
+}
+
+BaseType_t xTaskNotify(TaskHandle_t task, uint32_t value, eNotifyAction action) {
+    std::lock_guard<std::mutex> guard(task->lock);
+    switch (action) {
+        case eSetBits:
+            task->notify_value |= value;
+            break;
+        case eIncrement:
+            task->notify_value += 1;
+            break;
+        case eSetValueWithOverwrite:
+            task->notify_value = value;
+            break;
+        case eSetValueWithoutOverwrite:
+            if (task->notify_value) {
+                return pdFAIL;
+            }
+            task->notify_value = value;
+            break;
+        case eNoAction:
+            break;
+    }
+    task->notified.notify_all();
+    return pdPASS;
+}
+
+BaseType_t xTaskNotifyGive(TaskHandle_t task) {
+    return xTaskNotify(task, 0, eIncrement);
+}
+
+uint32_t ulTaskNotifyTake(BaseType_t clear_on_exit, TickType_t ticks_to_wait) {
+    HostTask* task = xTaskGetCurrentTaskHandle();
+    std::unique_lock<std::mutex> lock(task->lock);
+    WaitTicks(task->notified, lock, ticks_to_wait, [task]() { return task->notify_value != 0; });
+    uint32_t value = task->notify_value;
+    if (value) {
+        task->notify_value = clear_on_exit ? 0 : value - 1;
+    }
+    return value;
+}
+
+QueueHandle_t xQueueCreate(UBaseType_t length, UBaseType_t item_size) {
+    return new HostQueue(length, item_size);
+}
+
+QueueHandle_t xQueueHostCreateGiven() {
+    QueueHandle_t queue = xQueueCreate(1, 0);
+    xQueueSend(queue, NULL, 0);
+    return queue;
+}
+
+void vQueueDelete(QueueHandle_t queue) {
+    delete queue;
+}
+
+BaseType_t xQueueSend(QueueHandle_t queue, const void* item, TickType_t ticks_to_wait) {
+    std::unique_lock<std::mutex> lock(queue->lock);
+    if (!WaitTicks(queue->can_send, lock, ticks_to_wait,
+                   [queue]() { return queue->items.size() < queue->length; })) {
+        return pdFAIL;
+    }
+    const uint8_t* bytes = (const uint8_t*) item;
+    queue->items.emplace_back(bytes, bytes + (bytes ? queue->item_size : 0));
+    queue->can_receive.notify_one();
+    return pdPASS;
+}
+
+BaseType_t xQueueReceive(QueueHandle_t queue, void* item, TickType_t ticks_to_wait) {
+    std::unique_lock<std::mutex> lock(queue->lock);
+    queue->waiting_receivers += 1;
+    queue->receiver_waiting.notify_all();
+    bool received = WaitTicks(queue->can_receive, lock, ticks_to_wait,
+                              [queue]() { return !queue->items.empty(); });
+    queue->waiting_receivers -= 1;
+    if (!received) {
+        return pdFAIL;
+    }
+    if (item && queue->item_size) {
+        memcpy(item, queue->items.front().data(), queue->item_size);
+    }
+    queue->items.pop_front();
+    queue->can_send.notify_one();
+    return pdPASS;
+}
+
+UBaseType_t uxQueueMessagesWaiting(QueueHandle_t queue) {
+    std::lock_guard<std::mutex> guard(queue->lock);
+    return queue->items.size();
+}
+
+void vQueueHostWaitForReceiver(QueueHandle_t queue) {
+    std::unique_lock<std::mutex> lock(queue->lock);
+    queue->receiver_waiting.wait(lock, [queue]() {
+        return queue->items.empty() && (queue->waiting_receivers > 0);
+    });
+}
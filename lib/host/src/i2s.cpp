@@ -0,0 +1,112 @@
+#include "driver/i2s.h"
+
+#include <algorithm>
+#include <cstring>
+#include <mutex>
+
+namespace {
+    std::mutex g_lock;
+    const uint8_t* g_source = nullptr;
+    size_t g_source_bytes = 0;
+    size_t g_source_position = 0;
+    size_t g_chunk_bytes = 0;
+    size_t g_released_bytes = 0;
+    QueueHandle_t g_event_queue = nullptr;
+    bool g_is_adc_built_in = false;
+    uint16_t g_adc_channel = 0;
+
+    // The inverse of the default ADC conversion, 2048 - raw scaled by a gain of 15.
+    // Audio recorded through it comes back exactly, anything else is quantized to
+    // the ADC's 12 bits as it would be on the device.
+    constexpr int32_t kAdcMidScale = 2048;
+    constexpr int32_t kAdcGain = 15;
+
+    uint16_t EncodeAdcSample(int16_t sample) {
+        const int32_t scaled = (sample >= 0 ? sample + kAdcGain / 2 : sample - kAdcGain / 2) / kAdcGain;
+        const int32_t raw = std::min<int32_t>(std::max<int32_t>(kAdcMidScale - scaled, 0), 0xfff);
+        // The ADC puts its channel in the top bits.
+        return raw | (g_adc_channel << 12);
+    }
+
+    // Expects g_lock to be held.
+    void ReleaseChunk() {
+        const size_t remaining = g_source_bytes - g_source_position - g_released_bytes;
+        const size_t chunk = std::min(g_chunk_bytes, remaining);
+        g_released_bytes += chunk;
+        i2s_event_t evt = {I2S_EVENT_RX_DONE, chunk};
+        xQueueSend(g_event_queue, &evt, portMAX_DELAY);
+    }
+}
+
+void i2s_host_set_source(const int16_t* samples, size_t sample_count, size_t chunk_samples) {
+    std::lock_guard<std::mutex> guard(g_lock);
+    g_source = (const uint8_t*) samples;
+    g_source_bytes = sample_count * sizeof(int16_t);
+    g_source_position = 0;
+    g_chunk_bytes = chunk_samples * sizeof(int16_t);
+    g_released_bytes = 0;
+}
+
+bool i2s_host_advance() {
+    if (!g_event_queue) {
+        return false;
+    }
+    vQueueHostWaitForReceiver(g_event_queue);
+    {
+        std::lock_guard<std::mutex> guard(g_lock);
+        if (g_source_position + g_released_bytes >= g_source_bytes) {
+            return false;
+        }
+        ReleaseChunk();
+    }
+    vQueueHostWaitForReceiver(g_event_queue);
+    return true;
+}
+
+esp_err_t i2s_driver_install(i2s_port_t port, const i2s_config_t* config,
+                             int queue_size, QueueHandle_t* queue) {
+    std::lock_guard<std::mutex> guard(g_lock);
+    g_event_queue = xQueueCreate(queue_size, sizeof(i2s_event_t));
+    g_is_adc_built_in = (config->mode & I2S_MODE_ADC_BUILT_IN) != 0;
+    if (queue) {
+        *queue = g_event_queue;
+    }
+    if (g_source) {
+        ReleaseChunk();
+    }
+    return ESP_OK;
+}
+
+esp_err_t i2s_driver_uninstall(i2s_port_t port) {
+    std::lock_guard<std::mutex> guard(g_lock);
+    vQueueDelete(g_event_queue);
+    g_event_queue = nullptr;
+    return ESP_OK;
+}
+
+esp_err_t i2s_set_adc_mode(adc_unit_t adc_unit, adc1_channel_t adc_channel) {
+    std::lock_guard<std::mutex> guard(g_lock);
+    g_adc_channel = adc_channel;
+    return ESP_OK;
+}
+
+esp_err_t i2s_adc_enable(i2s_port_t port) { return ESP_OK; }
+
+esp_err_t i2s_zero_dma_buffer(i2s_port_t port) { return ESP_OK; }
+
+esp_err_t i2s_read(i2s_port_t port, void* dest, size_t size, size_t* bytes_read,
+                   TickType_t ticks_to_wait) {
+    std::lock_guard<std::mutex> guard(g_lock);
+    const size_t bytes = std::min(size, g_released_bytes);
+    memcpy(dest, g_source + g_source_position, bytes);
+    if (g_is_adc_built_in) {
+        uint16_t* words = (uint16_t*) dest;
+        for (size_t i = 0; i < bytes / sizeof(int16_t); ++i) {
+            words[i] = EncodeAdcSample((int16_t) words[i]);
+        }
+    }
+    g_source_position += bytes;
+    g_released_bytes -= bytes;
+    *bytes_read = bytes;
+    return ESP_OK;
+}
@@ -0,0 +1,53 @@
+#include "esp_partition.h"
+
+#include <cstring>
+#include <deque>
+
+namespace {
+    struct HostPartition {
+        esp_partition_t partition;
+        const uint8_t* data;
+    };
+    // A deque, so partitions already handed out don't move as more are added.
+    std::deque<HostPartition> g_partitions;
+}
+
+void esp_partition_host_add(esp_partition_subtype_t subtype, const char* label,
+                            const uint8_t* data, uint32_t size) {
+    g_partitions.emplace_back();
+    HostPartition* host_partition = &g_partitions.back();
+    host_partition->partition.type = ESP_PARTITION_TYPE_DATA;
+    host_partition->partition.subtype = subtype;
+    host_partition->partition.size = size;
+    strncpy(host_partition->partition.label, label, sizeof(host_partition->partition.label) - 1);
+    host_partition->data = data;
+}
+
+const esp_partition_t* esp_partition_find_first(esp_partition_type_t type,
+                                                esp_partition_subtype_t subtype,
+                                                const char* label) {
+    for (const HostPartition& host_partition : g_partitions) {
+        const esp_partition_t& partition = host_partition.partition;
+        if ((partition.type == type) &&
+            ((subtype == ESP_PARTITION_SUBTYPE_ANY) || (partition.subtype == subtype)) &&
+            (!label || (strcmp(partition.label, label) == 0))) {
+            return &partition;
+        }
+    }
+    return nullptr;
+}
+
+esp_err_t esp_partition_mmap(const esp_partition_t* partition, size_t offset, size_t size,
+                             spi_flash_mmap_memory_t memory, const void** out_ptr,
+                             spi_flash_mmap_handle_t* out_handle) {
+    if (offset + size > partition->size) {
+        return ESP_FAIL;
+    }
+    // The partition is the first member, so this gets back to its buffer.
+    const HostPartition* host_partition = reinterpret_cast<const HostPartition*>(partition);
+    *out_ptr = host_partition->data + offset;
+    *out_handle = 0;
+    return ESP_OK;
+}
+
+void spi_flash_munmap(spi_flash_mmap_handle_t handle) {}
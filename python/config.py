@@ -49,6 +49,12 @@ MODEL_TF = os.path.join(MODELS_DIR, 'model.pb')
 MODEL_TFLITE = os.path.join(MODELS_DIR, 'model.tflite')
 FLOAT_MODEL_TFLITE = os.path.join(MODELS_DIR, 'float_model.tflite')
 MODEL_TFLITE_MICRO = os.path.join(MODELS_DIR, 'model.cc')
+# The quantized model without its final Softmax, scored on logits by the firmware.
+MODEL_LOGITS_TFLITE = os.path.join(MODELS_DIR, 'model_logits.tflite')
+MODEL_LOGITS_TFLITE_MICRO = os.path.join(MODELS_DIR, 'model_logits.cc')
+# The streaming variant, invoked with one feature slice at a time.
+MODEL_STREAM_TFLITE = os.path.join(MODELS_DIR, 'model_stream.tflite')
+MODEL_STREAM_TFLITE_MICRO = os.path.join(MODELS_DIR, 'model_stream.cc')
 SAVED_MODEL = os.path.join(MODELS_DIR, 'saved_model')
 
 # Constants for Quantization
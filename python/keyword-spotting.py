@@ -14,6 +14,42 @@ if len(sys.argv) != 2:
     sys.exit()
 cmd = sys.argv[1]
 
+# Helper function to run the streaming model over the test set a slice at a time,
+# scoring each clip by the output after its last slice
+def run_tflite_stream_inference_testSet(tflite_model_path):
+    np.random.seed(0) # set random seed for reproducible test results.
+    with tf.compat.v1.Session() as sess:
+        test_data, test_labels = audio_processor.get_data(
+            -1, 0, model_settings, BACKGROUND_FREQUENCY, BACKGROUND_VOLUME_RANGE,
+            TIME_SHIFT_MS, 'testing', sess
+        )
+
+    interpreter = tf.lite.Interpreter(tflite_model_path)
+    interpreter.allocate_tensors()
+    inputs = interpreter.get_input_details()
+    outputs = interpreter.get_output_details()
+    slice_input = next(i for i in inputs if "feature_slice" in i["name"])
+    state_inputs = [i for i in inputs if i is not slice_input]
+    score_output = next(o for o in outputs if len(o["shape"]) == 2)
+    # The converter doesn't keep the order, pair each state with the output of its shape.
+    state_outputs = [next(o for o in outputs if list(o["shape"]) == list(i["shape"])) for i in state_inputs]
+    input_scale, input_zero_point = slice_input["quantization"]
+
+    correct_predictions = 0
+    for clip, label in zip(test_data, test_labels):
+        for state in state_inputs:
+            interpreter.set_tensor(state["index"], np.full(state["shape"], state["quantization"][1], state["dtype"]))
+        for feature_slice in clip.reshape(-1, FEATURE_BIN_COUNT):
+            quantized = (feature_slice / input_scale + input_zero_point).astype(slice_input["dtype"])
+            interpreter.set_tensor(slice_input["index"], quantized.reshape(slice_input["shape"]))
+            interpreter.invoke()
+            for state, next_state in zip(state_inputs, state_outputs):
+                interpreter.set_tensor(state["index"], interpreter.get_tensor(next_state["index"]))
+        top_prediction = interpreter.get_tensor(score_output["index"])[0].argmax()
+        correct_predictions += (top_prediction == label)
+
+    print(f"Streaming model accuracy is {(correct_predictions * 100) / len(test_data)}% (Number of test samples={len(test_data)})")
+
 # Helper function to run inference
 def run_tflite_inference_testSet(tflite_model_path, model_type="Float"):
     #
@@ -85,12 +121,43 @@ if cmd == "freeze":
                f"--output_file={SAVED_MODEL}"
                 ])
 
+def write_model_source(tflite_path, source_path):
+    subprocess.run(["xxd", "-i", tflite_path, source_path])
+    REPLACE_TEXT = tflite_path.replace('/', '_').replace('.', '_')
+    subprocess.run(["sed", "-i", f"s/{REPLACE_TEXT}/g_model/g", source_path])
+
 if cmd == "convert":
-    subprocess.run(["xxd", "-i", MODEL_TFLITE, MODEL_TFLITE_MICRO])
-    REPLACE_TEXT = MODEL_TFLITE.replace('/', '_').replace('.', '_')
-    subprocess.run(["sed", "-i", f"s/{REPLACE_TEXT}/g_model/g", MODEL_TFLITE_MICRO])
+    write_model_source(MODEL_TFLITE, MODEL_TFLITE_MICRO)
 
-if cmd == "eval":
+# Writes a variant of the quantized model that stops at the logits of the final
+# FullyConnected. The firmware smooths and thresholds those with integer math, and
+# saves running the Softmax kernel on every inference.
+if cmd == "logits":
+    from tensorflow.lite.tools import flatbuffer_utils
+    from tensorflow.lite.python import schema_py_generated as schema_fb
+
+    model = flatbuffer_utils.read_model(MODEL_TFLITE)
+    subgraph = model.subgraphs[0]
+    softmax = subgraph.operators[-1]
+    softmax_code = softmax.opcodeIndex
+    if ((model.operatorCodes[softmax_code].builtinCode != schema_fb.BuiltinOperator.SOFTMAX) or
+            (list(softmax.outputs) != list(subgraph.outputs))):
+        print(f"{MODEL_TFLITE} doesn't end in a Softmax")
+        sys.exit(1)
+    subgraph.outputs = softmax.inputs[:1]
+    del subgraph.operators[-1]
+    # Drop the Softmax op code too if nothing else uses it, so it isn't registered.
+    if all(op.opcodeIndex != softmax_code for op in subgraph.operators):
+        del model.operatorCodes[softmax_code]
+        for op in subgraph.operators:
+            if op.opcodeIndex > softmax_code:
+                op.opcodeIndex -= 1
+    flatbuffer_utils.write_model(model, MODEL_LOGITS_TFLITE)
+    print(f"Logits model is {os.path.getsize(MODEL_LOGITS_TFLITE)} bytes")
+    write_model_source(MODEL_LOGITS_TFLITE, MODEL_LOGITS_TFLITE_MICRO)
+
+def load_audio_processor():
+    global model_settings, audio_processor
     model_settings = models.prepare_model_settings(
         len(input_data.prepare_words_list(WANTED_WORDS.split(','))),
         SAMPLE_RATE, CLIP_DURATION_MS, WINDOW_SIZE_MS,
@@ -103,6 +170,9 @@ if cmd == "eval":
         TESTING_PERCENTAGE, model_settings, LOGS_DIR
     )
 
+if cmd == "eval":
+    load_audio_processor()
+
     with tf.compat.v1.Session() as sess:
         float_converter = tf.lite.TFLiteConverter.from_saved_model(SAVED_MODEL)
         float_tflite_model = float_converter.convert()
@@ -130,3 +200,78 @@ if cmd == "eval":
 
     run_tflite_inference_testSet(FLOAT_MODEL_TFLITE)
     run_tflite_inference_testSet(MODEL_TFLITE, model_type='Quantized')
+
+# Writes a streaming variant of the trained tiny_conv model, invoked with one feature
+# slice at a time instead of the whole window. The last slices the convolution needs
+# and the convolution's output rows for the window are kept as state, passed in and
+# returned as extra tensors, so each invoke only works out the newest row.
+# Rows come from the newest slices without the padding in time the windowed model sees
+# at the window's edges, so scores are close to but not exactly the windowed model's.
+if cmd == "stream":
+    load_audio_processor()
+    checkpoint = tf.train.load_checkpoint(f"{TRAIN_DIR}{MODEL_ARCHITECTURE}.ckpt-{TOTAL_STEPS}")
+    first_weights = checkpoint.get_tensor("first_weights")
+    first_bias = checkpoint.get_tensor("first_bias")
+    fc_weights = checkpoint.get_tensor("final_fc_weights")
+    fc_bias = checkpoint.get_tensor("final_fc_bias")
+
+    # tiny_conv's convolution has a stride of 2 in both time and frequency, and pads
+    # frequency the way 'SAME' does.
+    filter_time, filter_freq, _, filter_count = first_weights.shape
+    window_slices = model_settings['spectrogram_length']
+    row_width = (FEATURE_BIN_COUNT + 1) // 2
+    freq_padding = max((row_width - 1) * 2 + filter_freq - FEATURE_BIN_COUNT, 0)
+    row_size = row_width * filter_count
+    if fc_weights.shape[0] != ((window_slices + 1) // 2) * row_size:
+        print(f"{MODEL_ARCHITECTURE} doesn't look like tiny_conv")
+        sys.exit(1)
+
+    feature_slice = tf.keras.Input(shape=(FEATURE_BIN_COUNT,), batch_size=1, name="feature_slice")
+    feature_state = tf.keras.Input(shape=(filter_time - 1, FEATURE_BIN_COUNT), batch_size=1, name="feature_state")
+    row_state = tf.keras.Input(shape=(window_slices - 1, row_size), batch_size=1, name="row_state")
+    features = tf.keras.layers.Concatenate(axis=1)(
+        [feature_state, tf.keras.layers.Reshape((1, FEATURE_BIN_COUNT))(feature_slice)])
+    conv = tf.keras.layers.Conv2D(filter_count, (filter_time, filter_freq), strides=(1, 2), activation="relu")
+    padded = tf.keras.layers.ZeroPadding2D(((0, 0), (freq_padding // 2, freq_padding - freq_padding // 2)))(
+        tf.keras.layers.Reshape((filter_time, FEATURE_BIN_COUNT, 1))(features))
+    row = tf.keras.layers.Reshape((1, row_size))(conv(padded))
+    rows = tf.keras.layers.Concatenate(axis=1)([row_state, row])
+    # With the stride in time, the window's rows are every other one back from the newest.
+    window = tf.keras.layers.Lambda(lambda r: r[:, ::2, :])(rows)
+    dense = tf.keras.layers.Dense(fc_weights.shape[1])
+    scores = tf.keras.layers.Softmax()(dense(tf.keras.layers.Flatten()(window)))
+    next_feature_state = tf.keras.layers.Lambda(lambda f: f[:, 1:, :])(features)
+    next_row_state = tf.keras.layers.Lambda(lambda r: r[:, 1:, :])(rows)
+    stream_model = tf.keras.Model([feature_slice, feature_state, row_state],
+                                  [scores, next_feature_state, next_row_state])
+    conv.set_weights([first_weights, first_bias])
+    dense.set_weights([fc_weights, fc_bias])
+
+    # Quantize with the states the model goes through streaming real clips.
+    with tf.compat.v1.Session() as sess:
+        fingerprints, _ = audio_processor.get_data(20, 0, model_settings,
+                                                   BACKGROUND_FREQUENCY,
+                                                   BACKGROUND_VOLUME_RANGE,
+                                                   TIME_SHIFT_MS,
+                                                   'testing',
+                                                   sess)
+    def representative_dataset_gen():
+        for fingerprint in fingerprints:
+            state = [np.zeros((1, filter_time - 1, FEATURE_BIN_COUNT), np.float32),
+                     np.zeros((1, window_slices - 1, row_size), np.float32)]
+            for slice_data in fingerprint.reshape(window_slices, FEATURE_BIN_COUNT):
+                inputs = [slice_data.reshape(1, FEATURE_BIN_COUNT).astype(np.float32)] + state
+                yield inputs
+                state = [output.numpy() for output in stream_model(inputs)[1:]]
+
+    converter = tf.lite.TFLiteConverter.from_keras_model(stream_model)
+    converter.optimizations = [tf.lite.Optimize.DEFAULT]
+    converter.inference_input_type = tf.int8
+    converter.inference_output_type = tf.int8
+    converter.representative_dataset = representative_dataset_gen
+    stream_tflite_model = converter.convert()
+    stream_tflite_model_size = open(MODEL_STREAM_TFLITE, "wb").write(stream_tflite_model)
+    print(f"Streaming model is {stream_tflite_model_size} bytes")
+    write_model_source(MODEL_STREAM_TFLITE, MODEL_STREAM_TFLITE_MICRO)
+
+    run_tflite_stream_inference_testSet(MODEL_STREAM_TFLITE)
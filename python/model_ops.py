@@ -0,0 +1,239 @@
+#!/usr/bin/env python3
+# Generates include/ModelOps.h, the op resolver for exactly the ops a model uses.
+#
+#   python3 python/model_ops.py [model.tflite|src/model.cpp] [include/ModelOps.h]
+#
+# Only the kernels registered there are linked into the firmware, so a model that
+# needs an op TFLM doesn't have fails here instead of at AllocateTensors() on the
+# device. The flatbuffer is read directly, so this runs without TensorFlow.
+#
+# Built with MODEL_INT8_KERNELS, the heavy ops are registered with their int8-only
+# kernels, which optimized TFLM builds (ESP-NN, CMSIS-NN) implement directly.
+# Built with MODEL_STREAMING_OPS, the ops of the streaming model are registered too.
+
+import re
+import struct
+import sys
+
+# BuiltinOperator values from the TFLite schema, for the ops MicroMutableOpResolver
+# can register, with the name of its Add method.
+MICRO_OPS = {
+    0: "Add",
+    1: "AveragePool2D",
+    2: "Concatenation",
+    3: "Conv2D",
+    4: "DepthwiseConv2D",
+    6: "Dequantize",
+    8: "Floor",
+    9: "FullyConnected",
+    11: "L2Normalization",
+    14: "Logistic",
+    17: "MaxPool2D",
+    18: "Mul",
+    19: "Relu",
+    21: "Relu6",
+    22: "Reshape",
+    25: "Softmax",
+    27: "Svdf",
+    28: "Tanh",
+    34: "Pad",
+    40: "Mean",
+    41: "Sub",
+    45: "StridedSlice",
+    49: "Split",
+    54: "Prelu",
+    55: "Maximum",
+    56: "ArgMax",
+    57: "Minimum",
+    58: "Less",
+    59: "Neg",
+    60: "PadV2",
+    61: "Greater",
+    62: "GreaterEqual",
+    63: "LessEqual",
+    66: "Sin",
+    71: "Equal",
+    72: "NotEqual",
+    73: "Log",
+    75: "Sqrt",
+    76: "Rsqrt",
+    77: "Shape",
+    79: "ArgMin",
+    83: "Pack",
+    84: "LogicalOr",
+    86: "LogicalAnd",
+    87: "LogicalNot",
+    88: "Unpack",
+    92: "Square",
+    97: "ResizeNearestNeighbor",
+    101: "Abs",
+    102: "SplitV",
+    104: "Ceil",
+    108: "Cos",
+    114: "Quantize",
+    116: "Round",
+    117: "HardSwish",
+}
+
+# Ops with an int8-only registration, and the name of its Register function.
+INT8_KERNELS = {
+    "Conv2D": "Register_CONV_2D_INT8",
+    "DepthwiseConv2D": "Register_DEPTHWISE_CONV_2D_INT8",
+    "FullyConnected": "Register_FULLY_CONNECTED_INT8",
+}
+INT8_KERNEL_HEADERS = {
+    "Conv2D": "conv.h",
+    "DepthwiseConv2D": "depthwise_conv.h",
+    "FullyConnected": "fully_connected.h",
+}
+
+# The ops the streaming model (keyword-spotting.py stream) needs on top of the
+# windowed one's, and Quantize, which the converter adds where concatenated tensors
+# are quantized differently. Built with MODEL_STREAMING_OPS, they are registered too,
+# so a streaming model can be loaded into a model slot.
+STREAMING_OPS = ["Concatenation", "Conv2D", "Pad", "Quantize", "Reshape", "StridedSlice",
+                 "FullyConnected", "Softmax"]
+
+# Above this, newer schemas keep the op in builtin_code instead of the byte-sized
+# deprecated_builtin_code.
+PLACEHOLDER_FOR_GREATER_OP_CODES = 127
+CUSTOM_OP = 32
+
+
+def read_model(path):
+    """Returns the flatbuffer from a .tflite file, or from the g_model array of a .cpp."""
+    if not path.endswith((".cpp", ".cc")):
+        with open(path, "rb") as file:
+            return file.read()
+    with open(path) as file:
+        source = file.read()
+    array = re.search(r"g_model\[\]\s*=\s*\{(.*?)\};", source, re.S)
+    if not array:
+        raise ValueError(f"{path}: no g_model array")
+    return bytes(int(byte, 16) for byte in re.findall(r"0x([0-9a-fA-F]{2})", array.group(1)))
+
+
+class Table:
+    """Just enough of a flatbuffers table reader for the operator codes."""
+
+    def __init__(self, buf, pos):
+        self.buf = buf
+        self.pos = pos
+        self.vtable = pos - struct.unpack_from("<i", buf, pos)[0]
+        self.vtable_len = struct.unpack_from("<H", buf, self.vtable)[0]
+
+    def offset(self, field):
+        if 4 + 2 * field >= self.vtable_len:
+            return 0
+        return struct.unpack_from("<H", self.buf, self.vtable + 4 + 2 * field)[0]
+
+    def scalar(self, field, fmt, default=0):
+        offset = self.offset(field)
+        return struct.unpack_from(fmt, self.buf, self.pos + offset)[0] if offset else default
+
+    def tables(self, field):
+        offset = self.offset(field)
+        if not offset:
+            return []
+        vector = self.pos + offset + struct.unpack_from("<I", self.buf, self.pos + offset)[0]
+        count = struct.unpack_from("<I", self.buf, vector)[0]
+        elements = [vector + 4 + 4 * i for i in range(count)]
+        return [Table(self.buf, e + struct.unpack_from("<I", self.buf, e)[0]) for e in elements]
+
+
+def model_ops(buf):
+    if buf[4:8] != b"TFL3":
+        raise ValueError("not a TFLite model")
+    model = Table(buf, struct.unpack_from("<I", buf, 0)[0])
+    ops = []
+    # Model.operator_codes is field 1, and only lists the ops the model uses.
+    for code in model.tables(1):
+        builtin = code.scalar(0, "<b")
+        if builtin == PLACEHOLDER_FOR_GREATER_OP_CODES:
+            builtin = code.scalar(3, "<i")
+        if builtin == CUSTOM_OP:
+            raise ValueError("the model uses a custom op, register it by hand")
+        if builtin not in MICRO_OPS:
+            raise ValueError(f"the model uses builtin op {builtin}, which TFLM can't run")
+        if MICRO_OPS[builtin] not in ops:
+            ops.append(MICRO_OPS[builtin])
+    return ops
+
+
+def registration(op):
+    check = ("        return kTfLiteError;\n"
+             "    }\n")
+    if op not in INT8_KERNELS:
+        return f"    if (resolver->Add{op}() != kTfLiteOk) {{\n" + check
+    return ("#ifdef MODEL_INT8_KERNELS\n"
+            f"    if (resolver->Add{op}(tflite::{INT8_KERNELS[op]}()) != kTfLiteOk) {{\n"
+            "#else\n"
+            f"    if (resolver->Add{op}() != kTfLiteOk) {{\n"
+            "#endif\n" + check)
+
+
+def model_ops_header(ops):
+    streaming_ops = [op for op in STREAMING_OPS if op not in ops]
+    registrations = "".join(registration(op) for op in ops)
+    op_count = f"constexpr int kModelOpCount = {len(ops)};\n"
+    if streaming_ops:
+        registrations += ("#ifdef MODEL_STREAMING_OPS\n"
+                          + "".join(registration(op) for op in streaming_ops)
+                          + "#endif\n")
+        op_count = ("#ifdef MODEL_STREAMING_OPS\n"
+                    f"constexpr int kModelOpCount = {len(ops) + len(streaming_ops)};\n"
+                    "#else\n"
+                    f"{op_count}"
+                    "#endif\n")
+    kernel_includes = "".join(
+        f"#include \"tensorflow/lite/micro/kernels/{INT8_KERNEL_HEADERS[op]}\"\n"
+        for op in ops + streaming_ops if op in INT8_KERNELS)
+    if kernel_includes:
+        kernel_includes = f"#ifdef MODEL_INT8_KERNELS\n{kernel_includes}#endif\n"
+    return (
+        "#ifndef __MODELOPS_H_\n"
+        "#define __MODELOPS_H_\n"
+        "\n"
+        "#include \"tensorflow/lite/micro/micro_mutable_op_resolver.h\"\n"
+        f"{kernel_includes}"
+        "\n"
+        "// Written by python/model_ops.py from src/model.cpp, the build regenerates it\n"
+        "// when the model changes. Registers exactly the ops the model uses, shared by\n"
+        "// the firmware and the host tools. With MODEL_INT8_KERNELS the int8-only\n"
+        "// kernels are used where there are any. With MODEL_STREAMING_OPS the ones a\n"
+        "// streaming model needs are added.\n"
+        f"{op_count}"
+        "typedef tflite::MicroMutableOpResolver<kModelOpCount> ModelOpResolver;\n"
+        "\n"
+        "inline TfLiteStatus AddModelOps(ModelOpResolver* resolver) {\n"
+        f"{registrations}"
+        "    return kTfLiteOk;\n"
+        "}\n"
+        "\n"
+        "#endif // __MODELOPS_H_\n")
+
+
+def update_header(model_path, header_path):
+    """Rewrites the header if it doesn't match the model, returns True if it did."""
+    header = model_ops_header(model_ops(read_model(model_path)))
+    try:
+        with open(header_path) as file:
+            if file.read() == header:
+                return False
+    except FileNotFoundError:
+        pass
+    with open(header_path, "w") as file:
+        file.write(header)
+    return True
+
+
+if __name__ == "__main__":
+    model_path = sys.argv[1] if len(sys.argv) > 1 else "src/model.cpp"
+    header_path = sys.argv[2] if len(sys.argv) > 2 else "include/ModelOps.h"
+    try:
+        ops = model_ops(read_model(model_path))
+    except ValueError as error:
+        sys.exit(f"{model_path}: {error}")
+    print(f"{model_path} uses {', '.join(ops)}")
+    if update_header(model_path, header_path):
+        print(f"Wrote {header_path}")
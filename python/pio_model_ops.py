@@ -0,0 +1,19 @@
+# PlatformIO pre-build script: keeps include/ModelOps.h in step with src/model.cpp,
+# and stops the build if the model needs an op TFLM can't run.
+
+Import("env")
+
+import os
+import sys
+
+sys.path.insert(0, os.path.join(env["PROJECT_DIR"], "python"))
+import model_ops
+
+model_path = os.path.join(env["PROJECT_SRC_DIR"], "model.cpp")
+header_path = os.path.join(env["PROJECT_INCLUDE_DIR"], "ModelOps.h")
+try:
+    if model_ops.update_header(model_path, header_path):
+        print(f"Regenerated {header_path} for {model_path}")
+except ValueError as error:
+    sys.stderr.write(f"{model_path}: {error}\n")
+    env.Exit(1)
@@ -0,0 +1,64 @@
+#include "AdcConversion.h"
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+namespace {
+    constexpr uint16_t kAdcSampleMask = 0xfff;
+    // How quickly the offset estimate follows each block's mean, as a right shift.
+    constexpr int kDcOffsetSmoothingShift = 3;
+
+    int16_t Saturate(int32_t value) {
+        if (value > INT16_MAX) {
+            return INT16_MAX;
+        }
+        if (value < INT16_MIN) {
+            return INT16_MIN;
+        }
+        return value;
+    }
+}
+
+void ConvertAdcSamples(AdcConversion* conversion, const uint16_t* raw, int16_t* pcm, size_t count) {
+    if (count == 0) {
+        return;
+    }
+    const int32_t offset = conversion->remove_dc_offset ? (conversion->dc_offset_q8 + 128) >> 8 : 2048;
+    const int32_t gain = conversion->gain;
+    uint32_t sum = 0;
+    size_t i = 0;
+
+#if defined(__SSE2__)
+    const __m128i mask = _mm_set1_epi16(kAdcSampleMask);
+    const __m128i offsets = _mm_set1_epi16(offset);
+    const __m128i gains = _mm_set1_epi16(gain);
+    const __m128i ones = _mm_set1_epi16(1);
+    __m128i sums = _mm_setzero_si128();
+    for (; i + 8 <= count; i += 8) {
+        const __m128i samples = _mm_and_si128(_mm_loadu_si128((const __m128i*) (raw + i)), mask);
+        sums = _mm_add_epi32(sums, _mm_madd_epi16(samples, ones));
+        const __m128i centred = _mm_sub_epi16(offsets, samples);
+        // 16x16 bit products as 32-bit lanes, then packed back down with saturation.
+        const __m128i low = _mm_mullo_epi16(centred, gains);
+        const __m128i high = _mm_mulhi_epi16(centred, gains);
+        const __m128i products = _mm_packs_epi32(_mm_unpacklo_epi16(low, high),
+                                                 _mm_unpackhi_epi16(low, high));
+        _mm_storeu_si128((__m128i*) (pcm + i), products);
+    }
+    uint32_t lane_sums[4];
+    _mm_storeu_si128((__m128i*) lane_sums, sums);
+    sum = lane_sums[0] + lane_sums[1] + lane_sums[2] + lane_sums[3];
+#endif
+
+    for (; i < count; ++i) {
+        const int32_t sample = raw[i] & kAdcSampleMask;
+        sum += sample;
+        pcm[i] = Saturate((offset - sample) * gain);
+    }
+
+    if (conversion->remove_dc_offset) {
+        const int32_t mean_q8 = static_cast<int32_t>((static_cast<uint64_t>(sum) << 8) / count);
+        conversion->dc_offset_q8 += (mean_q8 - conversion->dc_offset_q8) >> kDcOffsetSmoothingShift;
+    }
+}
@@ -1,29 +1,107 @@
 #include "App.h"
-#include "model.h"
+#include "ModelLoader.h"
 #include "FeatureProvider.h"
+#include "FeatureWindow.h"
+#include "InferenceScheduler.h"
 #include "RecognizeLevels.h"
 #include "MicroModelSettings.h"
+#include "ModelOps.h"
+#include "TensorArenaSize.h"
+#include "model.h"
 #include "AudioProvider.h"
+#include "Profiler.h"
+#include "StreamingState.h"
 
 #include "tensorflow/lite/micro/micro_error_reporter.h"
 #include "tensorflow/lite/micro/micro_interpreter.h"
-#include "tensorflow/lite/micro/micro_mutable_op_resolver.h"
 #include "tensorflow/lite/schema/schema_generated.h"
 
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <new>
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/queue.h"
+#include "freertos/semphr.h"
+
 namespace {
     tflite::ErrorReporter* error_reporter = nullptr;
     const tflite::Model* model = nullptr;
     tflite::MicroInterpreter* interpreter = nullptr;
     TfLiteTensor* model_input = nullptr;
+    TfLiteTensor* model_output = nullptr;
+    // A streaming model is invoked with every slice rather than the whole window, and
+    // keeps the rest of the window in its state.
+    bool streaming_model = false;
+    StreamingState streaming_state;
     FeatureProvider* feature_provider = nullptr;
+    FeatureWindow* feature_window = nullptr;
     RecognizeLevels* recognizer = nullptr;
-    int32_t previous_time = 0;
+    InferenceScheduler* scheduler = nullptr;
+    int64_t previous_time = 0;
+    int64_t previous_report_time = 0;
+
+    // Slices on their way from the feature stage to the inference stage. A window's
+    // worth lets inference fall a whole window behind before slices are dropped.
+    constexpr int kSliceQueueLength = kFeatureSliceCount;
+    QueueHandle_t slice_queue = nullptr;
+
+    // How far behind each stage has got: audio waiting to be turned into features,
+    // and slices waiting for inference. Only kept as maximums since the last report.
+    // Each is updated by one stage and read and reset by the report from another.
+    std::atomic<int32_t> max_capture_backlog_ms(0);
+    std::atomic<uint32_t> max_queued_slices(0);
+    std::atomic<uint32_t> dropped_slices(0);
+
+    constexpr uint32_t kFeatureTaskStackSize = 8 * 1024;
+    constexpr uint32_t kInferenceTaskStackSize = 8 * 1024;
 
-    // Create an area of memory to use for input, output and intermediate arrays.
-    constexpr int kTensorArenaSize = 10 * 1024;
-    uint8_t tensor_arena[kTensorArenaSize];
-    int8_t feature_buffer[kFeatureElementCount];
+    // How often, in audio time, the per-stage timings and inference rate are logged.
+    constexpr int64_t kProfileReportIntervalMs = 60 * 1000;
+
+    // Create an area of memory to use for input, output and intermediate arrays, sized
+    // for the model by the arena_size tool.
+    alignas(16) uint8_t tensor_arena[kTensorArenaSize];
+    int8_t* feature_buffer = nullptr;
+    int8_t* separate_feature_buffer = nullptr;
     int8_t* model_input_buffer = nullptr;
+
+    // The interpreter is rebuilt over the same arena when switching models, so it lives
+    // in storage of its own rather than as a static.
+    alignas(tflite::MicroInterpreter) uint8_t interpreter_storage[sizeof(tflite::MicroInterpreter)];
+    ModelOpResolver* op_resolver = nullptr;
+    int model_slot = kBuiltInModelSlot;
+    // Held while the model is in use, so it is only switched between inferences.
+    SemaphoreHandle_t model_lock = nullptr;
+    AppScoreCallback score_callback = nullptr;
+
+    // Let the FeatureProvider keep its window directly in the model's input tensor,
+    // which saves a kFeatureElementCount buffer and turns the copy before every
+    // Invoke() into an in-place rotation.
+    // It is only used if no other tensor shares the input's memory in the arena,
+    // otherwise the kept slices would be overwritten during Invoke().
+    constexpr bool kFeaturesInInputTensor = true;
+}
+
+// True if no other non-constant tensor is placed over the input tensor's memory.
+bool InputTensorIsExclusive() {
+    const int8_t* input_start = model_input->data.int8;
+    const int8_t* input_end = input_start + model_input->bytes;
+    for (size_t i = 0; i < interpreter->tensors_size(); ++i) {
+        const TfLiteTensor* tensor = interpreter->tensor(i);
+        if ((tensor == model_input) || (tensor->data.int8 == nullptr) ||
+            (tensor->allocation_type == kTfLiteMmapRo)) {
+            continue;
+        }
+        const int8_t* tensor_start = tensor->data.int8;
+        const int8_t* tensor_end = tensor_start + tensor->bytes;
+        if ((tensor_start < input_end) && (input_start < tensor_end)) {
+            return false;
+        }
+    }
+    return true;
 }
 
 const char* getLevelText(PowerLevel level) {
@@ -40,122 +118,418 @@ const char* getLevelText(PowerLevel level) {
 }
 
 void RespondToLevel(tflite::ErrorReporter* error_reporter,
-                       int32_t current_time, PowerLevel level,
+                       int64_t current_time, PowerLevel level,
                        uint8_t score, bool is_new_level) {
     if (is_new_level) {
-        TF_LITE_REPORT_ERROR(error_reporter, "Heard %s (%d) @%dms", getLevelText(level));
+        TF_LITE_REPORT_ERROR(error_reporter, "Heard %s (%d) @%ds", getLevelText(level),
+                             score, static_cast<int32_t>(current_time / 1000));
     }
 }
 
-void setup_app() {
-    static tflite::MicroErrorReporter micro_error_reporter;
-    error_reporter = &micro_error_reporter;
+// (Re)builds the interpreter for new_model over the tensor arena, and checks its input
+// is the window of features we provide.
+TfLiteStatus BuildInterpreter(const tflite::Model* new_model) {
+    if (interpreter) {
+        interpreter->~MicroInterpreter();
+        interpreter = nullptr;
+        model_input = nullptr;
+    }
+    interpreter = new (interpreter_storage) tflite::MicroInterpreter(
+        new_model, *op_resolver, tensor_arena, kTensorArenaSize, error_reporter);
 
-    model = tflite::GetModel(g_model);
-    if (model->version() != TFLITE_SCHEMA_VERSION) {
-        TF_LITE_REPORT_ERROR(error_reporter,
-                             "Model provided is schema version %d not equal "
-                             "to supported version %d.",
-                             model->version(), TFLITE_SCHEMA_VERSION);
-        return;
+    // Allocate memory from the tensor_arena for the model's tensors.
+    TfLiteStatus allocate_status = interpreter->AllocateTensors();
+    if (allocate_status != kTfLiteOk) {
+      TF_LITE_REPORT_ERROR(error_reporter, "AllocateTensors() failed, kTensorArenaSize is %d bytes",
+                           kTensorArenaSize);
+      return kTfLiteError;
     }
+    TF_LITE_REPORT_ERROR(error_reporter, "Tensor arena: %d of %d bytes used",
+                         (int) interpreter->arena_used_bytes(), kTensorArenaSize);
 
-    static tflite::MicroMutableOpResolver<4> micro_op_resolver(error_reporter);
-    if (micro_op_resolver.AddDepthwiseConv2D() != kTfLiteOk) {
-        return;
+    // A windowed model's only input is the whole window of features. A streaming model
+    // takes one slice per Invoke(), and any state it keeps outside as more inputs.
+    int feature_input = -1;
+    bool streaming = false;
+    for (size_t i = 0; i < interpreter->inputs_size(); ++i) {
+        const TfLiteTensor* input = interpreter->input(i);
+        if ((input->dims->size == 2) && (input->dims->data[0] == 1) && (input->type == kTfLiteInt8) &&
+            ((input->dims->data[1] == kFeatureElementCount) || (input->dims->data[1] == kFeatureSliceSize))) {
+            feature_input = i;
+            streaming = (input->dims->data[1] == kFeatureSliceSize);
+            break;
+        }
     }
-    if (micro_op_resolver.AddFullyConnected() != kTfLiteOk) {
-        return;
+    if ((feature_input < 0) || (!streaming && (interpreter->inputs_size() != 1))) {
+        TF_LITE_REPORT_ERROR(error_reporter,
+                             "Bad input tensor parameters in model");
+        return kTfLiteError;
     }
-    if (micro_op_resolver.AddSoftmax() != kTfLiteOk) {
-        return;
+    int score_output = -1;
+    for (size_t i = 0; i < interpreter->outputs_size(); ++i) {
+        const TfLiteTensor* output = interpreter->output(i);
+        if ((output->dims->size == 2) && (output->dims->data[1] == kCategoryCount)) {
+            score_output = i;
+            break;
+        }
     }
-    if (micro_op_resolver.AddReshape() != kTfLiteOk) {
-        return;
+    if (score_output < 0) {
+        TF_LITE_REPORT_ERROR(error_reporter, "Bad output tensor parameters in model");
+        return kTfLiteError;
+    }
+    if (streaming && (streaming_state.Initialize(error_reporter, interpreter, feature_input,
+                                                 score_output) != kTfLiteOk)) {
+        return kTfLiteError;
     }
 
-    static tflite::MicroInterpreter static_interpreter(
-        model, micro_op_resolver, tensor_arena, kTensorArenaSize, error_reporter);
-    interpreter = &static_interpreter;
+    model = new_model;
+    model_input = interpreter->input(feature_input);
+    model_output = interpreter->output(score_output);
+    streaming_model = streaming;
+    model_input_buffer = model_input->data.int8;
+    return kTfLiteOk;
+}
 
-    // Allocate memory from the tensor_arena for the model's tensors.
-    TfLiteStatus allocate_status = interpreter->AllocateTensors();
-    if (allocate_status != kTfLiteOk) {
-      TF_LITE_REPORT_ERROR(error_reporter, "AllocateTensors() failed");
-      return;
+// Keeps the window of features in the input tensor when that's safe, otherwise in a
+// buffer of its own, starting it off with features in time order if there are any.
+void SetUpFeatureWindow(const int8_t* features) {
+    if (!streaming_model && kFeaturesInInputTensor && InputTensorIsExclusive()) {
+        feature_buffer = model_input_buffer;
+    } else {
+        if (!separate_feature_buffer) {
+            TF_LITE_REPORT_ERROR(error_reporter, "Keeping features in a separate buffer");
+            separate_feature_buffer = new int8_t[kFeatureElementCount];
+        }
+        feature_buffer = separate_feature_buffer;
+    }
+
+    static FeatureWindow static_feature_window(kFeatureElementCount, feature_buffer);
+    static_feature_window = FeatureWindow(kFeatureElementCount, feature_buffer);
+    feature_window = &static_feature_window;
+    if (features) {
+        memcpy(feature_buffer, features, kFeatureElementCount);
     }
+}
 
-    model_input = interpreter->input(0);
-    if ((model_input->dims->size != 2)
-        || (model_input->dims->data[0] != 1)
-        || (model_input->dims->data[1] != (kFeatureSliceCount * kFeatureSliceSize))
-        || (model_input->type != kTfLiteInt8)) {
+void setup_app() {
+    static tflite::MicroErrorReporter micro_error_reporter;
+    error_reporter = &micro_error_reporter;
+
+    size_t model_size = 0;
+    const uint8_t* model_data = LoadModel(error_reporter, &model_slot, &model_size);
+    if (!model_data) {
+        return;
+    }
+
+    if (kTensorArenaModelLen == 0) {
         TF_LITE_REPORT_ERROR(error_reporter,
-                             "Bad input tensor parameters in model");
+                             "kTensorArenaSize is a placeholder, run the arena_size tool to measure it");
+    } else if ((model_slot == kBuiltInModelSlot) && (g_model_len != kTensorArenaModelLen)) {
+        TF_LITE_REPORT_ERROR(error_reporter,
+                             "TensorArenaSize.h was generated for another model, rerun the arena_size tool");
+    }
+
+    static ModelOpResolver micro_op_resolver(error_reporter);
+    if (AddModelOps(&micro_op_resolver) != kTfLiteOk) {
         return;
     }
+    op_resolver = &micro_op_resolver;
 
+    if (BuildInterpreter(tflite::GetModel(model_data)) != kTfLiteOk) {
+        return;
+    }
     TF_LITE_REPORT_ERROR(error_reporter, "model_input->data.data = %d", model_input->data.data);
-    model_input_buffer = model_input->data.int8;
+    SetUpFeatureWindow(nullptr);
+
+    model_lock = xSemaphoreCreateMutex();
+    if (!model_lock) {
+        TF_LITE_REPORT_ERROR(error_reporter, "Couldn't create the model lock");
+        return;
+    }
 
-    static FeatureProvider static_feature_provider(kFeatureElementCount, feature_buffer);
+    // Features are quantized the way the model expects its input, whatever it was
+    // converted with.
+    static FeatureProvider static_feature_provider(model_input->params.scale,
+                                                   model_input->params.zero_point);
     feature_provider = &static_feature_provider;
 
+    slice_queue = xQueueCreate(kSliceQueueLength, sizeof(FeatureSlice));
+    if (!slice_queue) {
+        TF_LITE_REPORT_ERROR(error_reporter, "Couldn't create the slice queue");
+        return;
+    }
+
     static RecognizeLevels static_recognizer(error_reporter);
     recognizer = &static_recognizer;
 
+    static InferenceScheduler static_scheduler;
+    scheduler = &static_scheduler;
+    scheduler->ScoreEverySlice(streaming_model);
+
     previous_time = 0;
+    previous_report_time = 0;
 
     TF_LITE_REPORT_ERROR(error_reporter, "Setup Complete");
 }
 
-void loop_app() {
-    //TF_LITE_REPORT_ERROR(error_reporter, "Starting Loop");
-    const int32_t current_time = LatestAudioTimestamp();
-    //TF_LITE_REPORT_ERROR(error_reporter, "latest timestamp %d", current_time);
+// Generates the slices for the audio captured since the last run and queues them for
+// the inference stage. Slices that don't fit in the queue are dropped.
+void RunFeatureStage() {
+    const int64_t current_time = LatestAudioTimestamp();
+    const int32_t capture_backlog_ms = static_cast<int32_t>(current_time - previous_time);
+    if (capture_backlog_ms > max_capture_backlog_ms.load()) {
+        max_capture_backlog_ms.store(capture_backlog_ms);
+    }
+    int64_t first_step = 0;
     int how_many_new_slices = 0;
-    TfLiteStatus feature_status = feature_provider->PopulateFeatureData(
-        error_reporter, previous_time, current_time, &how_many_new_slices
+    TfLiteStatus feature_status = feature_provider->NewSteps(
+        error_reporter, previous_time, current_time, &first_step, &how_many_new_slices
     );
+    // Move on even if generation failed, audio that was missed won't come back.
+    previous_time = current_time;
     if (feature_status != kTfLiteOk) {
         TF_LITE_REPORT_ERROR(error_reporter, "Feature generation failed");
         return;
     }
 
-    //TF_LITE_REPORT_ERROR(error_reporter, "got features");
-    previous_time = current_time;
+    // Catching up after a stall comes as a burst of strides, which are fetched and fed
+    // to the frontend a few at a time.
+    int8_t slice_data[kMaxAudioStrides * kFeatureSliceSize];
+    FeatureSlice slice;
+    for (int done = 0; done < how_many_new_slices;) {
+        const int burst_count = std::min(kMaxAudioStrides, how_many_new_slices - done);
+        feature_status = feature_provider->GenerateFeatureSlices(
+            error_reporter, first_step + done, burst_count, slice_data);
+        if (feature_status != kTfLiteOk) {
+            TF_LITE_REPORT_ERROR(error_reporter, "Feature generation failed");
+            return;
+        }
+        for (int i = 0; i < burst_count; ++i) {
+            // Each slice is timed a stride before the next, ending at the newest, so a
+            // streaming model's results are spread over time like the audio they came from.
+            const int slices_after = how_many_new_slices - 1 - (done + i);
+            slice.time_in_ms = current_time - (slices_after * kFeatureSliceStrideMs);
+            memcpy(slice.data, slice_data + (i * kFeatureSliceSize), kFeatureSliceSize);
+            if (xQueueSend(slice_queue, &slice, 0) != pdPASS) {
+                ++dropped_slices;
+            }
+        }
+        done += burst_count;
+    }
+}
+
+void AddSlicesAndInvoke(const FeatureSlice* first_slice);
+
+// Adds every queued slice to the window, waiting up to ticks_to_wait for the first,
+// then runs the model on the window if it is scheduled.
+void RunInferenceStage(TickType_t ticks_to_wait) {
+    FeatureSlice slice;
+    if (xQueueReceive(slice_queue, &slice, ticks_to_wait) != pdPASS) {
+        return;
+    }
+    const uint32_t queued_slices = uxQueueMessagesWaiting(slice_queue) + 1;
+    if (queued_slices > max_queued_slices.load()) {
+        max_queued_slices.store(queued_slices);
+    }
 
-    if (how_many_new_slices == 0) {
-        TF_LITE_REPORT_ERROR(error_reporter, "no slices");
+    xSemaphoreTake(model_lock, portMAX_DELAY);
+    // No model_input means a failed model switch left no working interpreter.
+    if (model_input) {
+        AddSlicesAndInvoke(&slice);
+    }
+    xSemaphoreGive(model_lock);
+}
+
+void InvokeAndRecognize(int64_t current_time);
+
+// Adds first_slice and the rest of the queued slices to the window, then runs the model
+// on it if scheduled. A streaming model is run on every slice instead. Expects the model
+// lock to be held.
+void AddSlicesAndInvoke(const FeatureSlice* first_slice) {
+    FeatureSlice slice = *first_slice;
+    int how_many_new_slices = 0;
+    int64_t current_time;
+    do {
+        memcpy(feature_window->NextSlice(), slice.data, kFeatureSliceSize);
+        feature_window->CommitSlice();
+        ++how_many_new_slices;
+        current_time = slice.time_in_ms;
+        if (streaming_model && scheduler->ShouldInvoke(1)) {
+            memcpy(model_input_buffer, slice.data, kFeatureSliceSize);
+            InvokeAndRecognize(current_time);
+        }
+    } while (xQueueReceive(slice_queue, &slice, 0) == pdPASS);
+    if (streaming_model) {
         return;
     }
 
-    //TF_LITE_REPORT_ERROR(error_reporter, "copying features");
-    for (int i = 0; i < kFeatureElementCount; i++) {
-        model_input_buffer[i] = feature_buffer[i];
+    // Features are kept up to date every stride, but the model only runs when scheduled.
+    if (!scheduler->ShouldInvoke(how_many_new_slices)) {
+        return;
     }
 
-    //TF_LITE_REPORT_ERROR(error_reporter, "invoking");
+    uint32_t copy_start = ProfileNow();
+    feature_window->LinearizeFeatureData(model_input_buffer);
+    ProfileRecord(kProfileFeatureCopy, copy_start);
+    InvokeAndRecognize(current_time);
+}
+
+// Runs the model on its input and acts on the results.
+void InvokeAndRecognize(int64_t current_time) {
+    uint32_t invoke_start = ProfileNow();
     TfLiteStatus invoke_status = interpreter->Invoke();
+    ProfileRecord(kProfileInvoke, invoke_start);
     if (invoke_status != kTfLiteOk) {
         TF_LITE_REPORT_ERROR(error_reporter, "Invoke failed");
         return;
     }
 
-    //TF_LITE_REPORT_ERROR(error_reporter, "copying output");
-    TfLiteTensor* output = interpreter->output(0);
-    PowerLevel* found_level = new PowerLevel[1];
+    TfLiteTensor* output = model_output;
+    if (score_callback) {
+        score_callback(current_time, output->data.int8, output->dims->data[output->dims->size - 1]);
+    }
+    PowerLevel found_level = NONE;
     uint8_t score = 0;
     bool is_new_level = false;
-    //TF_LITE_REPORT_ERROR(error_reporter, "processing results: %d", output);
+    uint32_t process_start = ProfileNow();
     TfLiteStatus process_status = recognizer->ProcessLatestResults(
-        output, current_time, found_level, &score, &is_new_level
+        output, current_time, &found_level, &score, &is_new_level
                                                                    );
+    ProfileRecord(kProfilePostProcess, process_start);
+    // Only now that the scores have been read, as the arena may have put them over the
+    // state inputs.
+    if (streaming_model) {
+        streaming_state.Carry();
+    }
     if (process_status != kTfLiteOk) {
         TF_LITE_REPORT_ERROR(error_reporter,
                              "RecognizeLevels::ProcessLatestResults() failed");
         return;
     }
-    //TF_LITE_REPORT_ERROR(error_reporter, "responding");
-    RespondToLevel(error_reporter, current_time, *found_level, score, is_new_level);
+    scheduler->UpdateResults(score, recognizer->DetectionThreshold(), is_new_level);
+    RespondToLevel(error_reporter, current_time, found_level, score, is_new_level);
+
+    if (current_time - previous_report_time >= kProfileReportIntervalMs) {
+        report_app();
+        previous_report_time = current_time;
+    }
+}
+
+void FeatureTask(void* param) {
+    while (true) {
+        RunFeatureStage();
+        // Sleep until capture completes the stride after the ones already turned into
+        // features, rather than polling the capture clock.
+        const int64_t next_stride_end_ms =
+            ((previous_time / kFeatureSliceStrideMs) + 1) * kFeatureSliceStrideMs;
+        WaitForAudio(next_stride_end_ms, portMAX_DELAY);
+    }
+}
+
+void InferenceTask(void* param) {
+    while (true) {
+        RunInferenceStage(portMAX_DELAY);
+    }
+}
+
+void start_app_tasks() {
+    if (!scheduler) {
+        TF_LITE_REPORT_ERROR(error_reporter, "Setup failed, not starting the pipeline");
+        return;
+    }
+    // Features are generated on core 0 next to the I2S reader, the interpreter gets
+    // core 1, which it only shares with the Arduino loop.
+    xTaskCreatePinnedToCore(FeatureTask, "Features", kFeatureTaskStackSize, NULL, 5, NULL, 0);
+    xTaskCreatePinnedToCore(InferenceTask, "Inference", kInferenceTaskStackSize, NULL, 2, NULL, 1);
+}
+
+void loop_app() {
+    RunFeatureStage();
+    RunInferenceStage(0);
+}
+
+bool switch_app_model(int slot) {
+    if (!model_lock) {
+        return false;
+    }
+    // Loaded under the lock too, so the mappings only change between inferences.
+    xSemaphoreTake(model_lock, portMAX_DELAY);
+    if (!model_input) {
+        xSemaphoreGive(model_lock);
+        TF_LITE_REPORT_ERROR(error_reporter, "Inference has stopped, restart to use another model");
+        return false;
+    }
+    if (slot == model_slot) {
+        // Remapping it would pull the flash from under the running interpreter.
+        xSemaphoreGive(model_lock);
+        TF_LITE_REPORT_ERROR(error_reporter, "Model slot %d is already running", slot);
+        return false;
+    }
+    size_t model_size = 0;
+    const uint8_t* model_data = LoadModelSlot(error_reporter, slot, &model_size);
+    if (!model_data) {
+        xSemaphoreGive(model_lock);
+        return false;
+    }
+
+    // The new model's tensors will overwrite the window if it is in the input tensor.
+    int8_t* features = new int8_t[kFeatureElementCount];
+    feature_window->LinearizeFeatureData(features);
+    const tflite::Model* previous_model = model;
+    const float input_scale = model_input->params.scale;
+    const int32_t input_zero_point = model_input->params.zero_point;
+
+    TfLiteStatus switch_status = BuildInterpreter(tflite::GetModel(model_data));
+    if ((switch_status == kTfLiteOk) &&
+        ((model_input->params.scale != input_scale) || (model_input->params.zero_point != input_zero_point))) {
+        // Features are quantized for the model set up at boot.
+        TF_LITE_REPORT_ERROR(error_reporter, "The new model's input quantization is different, "
+                             "restart to use it");
+        switch_status = kTfLiteError;
+    }
+    if (switch_status != kTfLiteOk) {
+        // Roll back to the model that was running, which is known to work.
+        const TfLiteStatus rollback_status = BuildInterpreter(previous_model);
+        UnloadModelSlot(slot);
+        if (rollback_status != kTfLiteOk) {
+            // Without a working interpreter, RunInferenceStage drops the slices.
+            model_input = nullptr;
+            TF_LITE_REPORT_ERROR(error_reporter, "Couldn't rebuild model slot %d either, "
+                                 "inference has stopped", model_slot);
+            delete[] features;
+            xSemaphoreGive(model_lock);
+            return false;
+        }
+        TF_LITE_REPORT_ERROR(error_reporter, "Couldn't switch to model slot %d, keeping %d", slot, model_slot);
+    } else {
+        UnloadModelSlot(model_slot);
+        model_slot = slot;
+        recognizer->Reset();
+        TF_LITE_REPORT_ERROR(error_reporter, "Switched to model slot %d", slot);
+    }
+    SetUpFeatureWindow(features);
+    delete[] features;
+    scheduler->ScoreEverySlice(streaming_model);
+    xSemaphoreGive(model_lock);
+    return switch_status == kTfLiteOk;
+}
+
+void set_app_score_callback(AppScoreCallback callback) {
+    // Taken with the model lock so it never changes during an inference.
+    if (model_lock) {
+        xSemaphoreTake(model_lock, portMAX_DELAY);
+    }
+    score_callback = callback;
+    if (model_lock) {
+        xSemaphoreGive(model_lock);
+    }
+}
+
+void report_app() {
+    ReportStageProfiles(error_reporter);
+    scheduler->ReportInferenceRate(error_reporter);
+    TF_LITE_REPORT_ERROR(error_reporter,
+                         "Pipeline: capture backlog up to %dms, up to %d slices queued, %d dropped",
+                         max_capture_backlog_ms.exchange(0), max_queued_slices.exchange(0),
+                         dropped_slices.load());
 }
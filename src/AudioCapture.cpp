@@ -0,0 +1,95 @@
+#include "AudioCapture.h"
+
+#include <cstdlib>
+
+#include "esp_log.h"
+
+static const char* TAG = "AUDIO_CAPTURE";
+
+AudioCapture::AudioCapture(i2s_port_t port, adc_unit_t adc_unit, adc1_channel_t adc_channel,
+                           const AdcConversion& conversion)
+    : _sink_count(0),
+      _port(port),
+      _adc_unit(adc_unit),
+      _adc_channel(adc_channel),
+      _conversion(conversion),
+      _is_adc_built_in(false),
+      _i2s_queue(nullptr),
+      _read_buffer(nullptr),
+      _read_buffer_bytes(0) {}
+
+bool AudioCapture::AddSink(AudioSink* sink) {
+    const int sink_count = _sink_count;
+    if (sink_count >= kMaxSinks) {
+        ESP_LOGE(TAG, "Too many audio sinks, at most %d", kMaxSinks);
+        return false;
+    }
+    _sinks[sink_count] = sink;
+    // Publish the count after the pointer, the reader task only looks at sinks below it.
+    __atomic_store_n(&_sink_count, sink_count + 1, __ATOMIC_RELEASE);
+    return true;
+}
+
+bool AudioCapture::Start(const i2s_config_t& config, BaseType_t core_id, UBaseType_t priority) {
+    // Read one DMA buffer at a time.
+    _read_buffer_bytes = config.dma_buf_len * sizeof(int16_t);
+    _read_buffer = (uint16_t*) malloc(_read_buffer_bytes);
+    if (!_read_buffer) {
+        ESP_LOGE(TAG, "Error allocating I2S read buffer");
+        return false;
+    }
+    _is_adc_built_in = (config.mode & I2S_MODE_ADC_BUILT_IN) != 0;
+
+    esp_err_t ret = i2s_driver_install(_port, &config, 4, &_i2s_queue);
+    if (ret != ESP_OK) {
+        ESP_LOGE(TAG, "Error in i2s_driver_install");
+        free(_read_buffer);
+        _read_buffer = nullptr;
+        return false;
+    }
+    if (_is_adc_built_in) {
+        i2s_set_adc_mode(_adc_unit, _adc_channel);
+        i2s_adc_enable(_port);
+    }
+    ret = i2s_zero_dma_buffer(_port);
+    if (ret != ESP_OK) {
+        ESP_LOGE(TAG, "Error in initializing dma buffer with 0");
+    }
+
+    xTaskCreatePinnedToCore(ReaderTask, "AudioCapture", 4096, this, priority, NULL, core_id);
+    return true;
+}
+
+void AudioCapture::ReaderTask(void* param) {
+    AudioCapture* capture = (AudioCapture*) param;
+    while (true) {
+        i2s_event_t evt;
+        if (xQueueReceive(capture->_i2s_queue, &evt, portMAX_DELAY) == pdPASS) {
+            if (evt.type == I2S_EVENT_RX_DONE) {
+                capture->ReadAvailable();
+            }
+        }
+    }
+}
+
+void AudioCapture::ReadAvailable() {
+    size_t bytes_read;
+    do {
+        // Don't wait, just drain the DMA buffers that are already full.
+        bytes_read = 0;
+        i2s_read(_port, _read_buffer, _read_buffer_bytes, &bytes_read, 0);
+        const size_t count = bytes_read / sizeof(int16_t);
+        if (count == 0) {
+            break;
+        }
+
+        int16_t* samples = (int16_t*) _read_buffer;
+        if (_is_adc_built_in) {
+            ConvertAdcSamples(&_conversion, _read_buffer, samples, count);
+        }
+        const int sink_count = __atomic_load_n(&_sink_count, __ATOMIC_ACQUIRE);
+        for (int i = 0; i < sink_count; ++i) {
+            _sinks[i]->WriteSamples(samples, count);
+        }
+    } while (bytes_read == _read_buffer_bytes);
+}
@@ -5,7 +5,7 @@
 
 #include "freertos/FreeRTOS.h"
 
-#include "driver/i2s.h"
+#include "AudioCapture.h"
 #include "esp_log.h"
 #include "esp_spi_flash.h"
 #include "esp_system.h"
@@ -18,26 +18,87 @@ using namespace std;
 
 static const char* TAG = "TF_LITE_AUDIO_PROVIDER";
 ringbuf_t* g_audio_capture_buffer;
-volatile int32_t g_latest_audio_timestamp = 0;
 
-constexpr int32_t history_samples_to_keep = ((kFeatureSliceDurationMs - kFeatureSliceStrideMs) *
-    (kAudioSampleFrequency / 1000));
+// Samples captured since recording started, only written by the capture task. A 64-bit
+// count can't be read in one go on the ESP32, so it is guarded by a sequence number
+// that is odd while an update is in progress.
+volatile uint64_t g_captured_samples = 0;
+volatile uint32_t g_captured_samples_sequence = 0;
 
-constexpr int32_t new_samples_to_get = (kFeatureSliceStrideMs * (kAudioSampleFrequency / 1000));
+constexpr int32_t kMaxSamplesToGet = kMaxAudioStrides * kFeatureSliceStrideSamples;
 
 namespace {
-    int16_t g_audio_output_buffer[kMaxAudioSampleSize];
+    // Capture is started once, and only the wait for its first samples is retried.
+    bool g_is_audio_capture_started = false;
     bool g_is_audio_initialized = false;
-    int16_t g_history_buffer[history_samples_to_keep];
+    uint32_t g_peeked_position = 0;
+    int64_t g_peeked_start_ms = 0;
+    const int16_t g_silence[kMaxSamplesToGet] = {};
+    // The task blocked in WaitForAudioSamples(), if any.
+    TaskHandle_t g_audio_waiter = nullptr;
+    // How long to wait for capture to start before giving up.
+    constexpr TickType_t kAudioStartTimeoutTicks = pdMS_TO_TICKS(1000);
 }
 
-const int32_t kAudioCaptureBufferSize = 80000;
-const int32_t i2s_bytes_to_read = 3200;
+// The capture buffer keeps the most recent audio, overwriting the oldest. Sample n
+// of the recording lives at byte position n * 2 of the ring (modulo 2^32, as the
+// ring's positions are free running), which is how audio is looked up by time.
+constexpr int32_t kSamplesPerMs = kAudioSampleFrequency / 1000;
+
+static void AddCapturedSamples(uint32_t samples) {
+    __atomic_store_n(&g_captured_samples_sequence, g_captured_samples_sequence + 1, __ATOMIC_SEQ_CST);
+    g_captured_samples = g_captured_samples + samples;
+    __atomic_store_n(&g_captured_samples_sequence, g_captured_samples_sequence + 1, __ATOMIC_SEQ_CST);
+}
+
+// About 2s of audio, kept a power of two so the ring buffer doesn't round it up.
+const int32_t kAudioCaptureBufferSize = 64 * 1024;
+
+namespace {
+    // Keeps the capture buffer that features are read from, and the capture clock.
+    class CaptureBufferSink : public AudioSink {
+    public:
+        void WriteSamples(const int16_t* samples, size_t count) override {
+            const uint64_t strides_before = g_captured_samples / kFeatureSliceStrideSamples;
+            int bytes_written = rb_write_overwrite(g_audio_capture_buffer, (const uint8_t*) samples,
+                                                   count * sizeof(int16_t));
+            if (bytes_written <= 0) {
+                ESP_LOGE(TAG, "Could not write in Ring Buffer: %d ", bytes_written);
+            } else {
+                AddCapturedSamples(bytes_written / sizeof(int16_t));
+                // Only wake the waiter once there is a whole new stride to work on.
+                if (g_captured_samples / kFeatureSliceStrideSamples != strides_before) {
+                    TaskHandle_t waiter = __atomic_load_n(&g_audio_waiter, __ATOMIC_SEQ_CST);
+                    if (waiter) {
+                        xTaskNotifyGive(waiter);
+                    }
+                }
+            }
+        }
+    };
+
+    CaptureBufferSink g_capture_buffer_sink;
+    AudioCapture g_audio_capture(I2S_NUM_0, ADC_UNIT_1, ADC1_CHANNEL_7);
+}
+
+AudioCapture* GetAudioCapture() { return &g_audio_capture; }
+
+static TfLiteStatus StartAudioCapture(tflite::ErrorReporter* error_reporter) {
+    if (g_is_audio_capture_started) {
+        return kTfLiteOk;
+    }
+    if (!g_audio_capture_buffer) {
+        g_audio_capture_buffer = rb_init("tf_ringbuffer", kAudioCaptureBufferSize);
+        if (!g_audio_capture_buffer) {
+            ESP_LOGE(TAG, "Error creating ring buffer");
+            return kTfLiteError;
+        }
+        g_audio_capture.AddSink(&g_capture_buffer_sink);
+    }
 
-static void i2s_init(QueueHandle_t* i2sQueue) {
     i2s_config_t i2s_config = {
       .mode = (i2s_mode_t)(I2S_MODE_MASTER | I2S_MODE_RX | I2S_MODE_ADC_BUILT_IN),
-      .sample_rate = 16000,
+      .sample_rate = kAudioSampleFrequency,
       .bits_per_sample = I2S_BITS_PER_SAMPLE_16BIT,
       .channel_format = I2S_CHANNEL_FMT_ONLY_LEFT,
       .communication_format = I2S_COMM_FORMAT_I2S_LSB,
@@ -48,69 +109,33 @@ static void i2s_init(QueueHandle_t* i2sQueue) {
       .tx_desc_auto_clear = false,
       .fixed_mclk = 0,
     };
-    adc_unit_t adcUnit = ADC_UNIT_1;
-    adc1_channel_t adcChannel = ADC1_CHANNEL_7;
-    esp_err_t ret = 0;
-    ret = i2s_driver_install(I2S_NUM_0, &i2s_config, 4, i2sQueue);
-    i2s_set_adc_mode(adcUnit, adcChannel);
-    i2s_adc_enable(I2S_NUM_0);
-    if (ret != ESP_OK) {
-        ESP_LOGE(TAG, "Error in i2s_driver_install");
-    }
-    ret = i2s_zero_dma_buffer(I2S_NUM_0);
-    if (ret != ESP_OK) {
-        ESP_LOGE(TAG, "Error in initializing dma buffer with 0");
-    }
-}
-
-static void CaptureSamples(void* arg) {
-    QueueHandle_t i2sQueue;
-    size_t bytes_read;
-    uint8_t i2s_read_buffer[i2s_bytes_to_read] = {};
-    i2s_init(&i2sQueue);
-    while (1) {
-        i2s_event_t evt;
-        if (xQueueReceive(i2sQueue, &evt, portMAX_DELAY) == pdPASS) {
-            if (evt.type == I2S_EVENT_RX_DONE) {
-                // read 100ms data at once from i2s
-                i2s_read(I2S_NUM_0, (void*)i2s_read_buffer, i2s_bytes_to_read, &bytes_read, 10);
-                if (bytes_read <= 0) {
-                    ESP_LOGE(TAG, "Error in I2S read: %d", bytes_read);
-                } else {
-                    if (bytes_read < i2s_bytes_to_read) {
-                        ESP_LOGW(TAG, "Partial I2S read");
-                    }
-                    int bytes_written = rb_write(g_audio_capture_buffer,
-                                         (uint8_t*) i2s_read_buffer, bytes_read, 10);
-                    g_latest_audio_timestamp += ((1000 * (bytes_written / 2)) / kAudioSampleFrequency);
-                    if (bytes_written <= 0) {
-                        ESP_LOGE(TAG, "Could not write in Ring Buffer: %d ", bytes_written);
-                    } else if (bytes_written < bytes_read) {
-                        ESP_LOGW(TAG, "Partial Write");
-                    }
-                }
-            }
-        }
+    if (!g_audio_capture.Start(i2s_config)) {
+        TF_LITE_REPORT_ERROR(error_reporter, "Couldn't start audio capture");
+        return kTfLiteError;
     }
-    vTaskDelete(NULL);
+    g_is_audio_capture_started = true;
+    return kTfLiteOk;
 }
 
+// Safe to call again after it fails: the buffer and capture engine are only set up
+// once, so a retry just waits for the first samples again.
 TfLiteStatus InitAudioRecording(tflite::ErrorReporter* error_reporter) {
-    g_audio_capture_buffer = rb_init("tf_ringbuffer", kAudioCaptureBufferSize);
-    if (!g_audio_capture_buffer) {
-        ESP_LOGE(TAG, "Error creating ring buffer");
+    TfLiteStatus start_status = StartAudioCapture(error_reporter);
+    if (start_status != kTfLiteOk) {
+        return start_status;
+    }
+    if (!WaitForAudioSamples(1, kAudioStartTimeoutTicks)) {
+        TF_LITE_REPORT_ERROR(error_reporter, "No audio captured after %dms",
+                             kAudioStartTimeoutTicks * portTICK_PERIOD_MS);
         return kTfLiteError;
     }
-
-    xTaskCreate(CaptureSamples, "CaptureSamples", 1024 * 32, NULL, 10, NULL);
-    while (!g_latest_audio_timestamp);
     ESP_LOGI(TAG, "Audio Recording started");
     return kTfLiteOk;
 }
 
 TfLiteStatus GetAudioSamples(tflite::ErrorReporter* error_reporter,
-                             int start_ms, int duration_ms,
-                             int* audio_samples_size, int16_t** audio_samples) {
+                             int64_t start_ms, int duration_ms,
+                             AudioSegments* audio_segments) {
     if (!g_is_audio_initialized) {
         TfLiteStatus init_status = InitAudioRecording(error_reporter);
         if (init_status != kTfLiteOk) {
@@ -119,33 +144,110 @@ TfLiteStatus GetAudioSamples(tflite::ErrorReporter* error_reporter,
         g_is_audio_initialized = true;
     }
 
-    // copy 160 samples (320 bytes) into output_buff from history
-    memcpy((void*)(g_audio_output_buffer), (void*)(g_history_buffer),
-           history_samples_to_keep * sizeof(int16_t));
-
-    // copy 320 samples (640 bytes) from rb at (int16_t*(g_audio_output_buffer) + 160),
-    // first 160 samples (320 bytes) will be from history
-    int32_t bytes_read = rb_read(g_audio_capture_buffer,
-                                 ((uint8_t*)(g_audio_output_buffer + history_samples_to_keep)),
-                                 new_samples_to_get * sizeof(int16_t), 10);
-
-    if (bytes_read < 0) {
-        ESP_LOGE(TAG, " Model could no read data from Ring Buffer");
-    } else if (bytes_read < new_samples_to_get * sizeof(int16_t)) {
-        ESP_LOGD(TAG, "RB FILLED RIGHT NOW IS %d",
-                 rb_filled(g_audio_capture_buffer));
-        ESP_LOGD(TAG, " Partial Read of Data by Model ");
-        ESP_LOGV(TAG, " Could only read %d bytes when required %d bytes ",
-                 bytes_read, new_samples_to_get * sizeof(int16_t));
+    // The new samples are all but the start of the first window, which overlaps the
+    // stride before and which the frontend already has.
+    const int new_duration_ms = duration_ms - (kFeatureSliceDurationMs - kFeatureSliceStrideMs);
+    const int32_t new_samples_to_get = new_duration_ms * kSamplesPerMs;
+    if ((new_samples_to_get <= 0) || (new_samples_to_get > kMaxSamplesToGet)) {
+        TF_LITE_REPORT_ERROR(error_reporter, "Can't get %dms of new audio at once, at most %dms",
+                             new_duration_ms, kMaxAudioStrides * kFeatureSliceStrideMs);
+        return kTfLiteError;
+    }
+
+    audio_segments->samples[0] = nullptr;
+    audio_segments->sizes[0] = 0;
+    audio_segments->samples[1] = nullptr;
+    audio_segments->sizes[1] = 0;
+    audio_segments->samples[2] = g_silence;
+    audio_segments->sizes[2] = new_samples_to_get;
+
+    const int64_t stride_start_ms = start_ms + duration_ms - new_duration_ms;
+    g_peeked_start_ms = stride_start_ms;
+    if (stride_start_ms < 0) {
+        // From before recording started.
+        g_peeked_position = rb_write_position(g_audio_capture_buffer);
+        return kTfLiteOk;
+    }
+
+    g_peeked_position = static_cast<uint32_t>(stride_start_ms * kSamplesPerMs * sizeof(int16_t));
+    uint8_t* segment1 = nullptr;
+    uint8_t* segment2 = nullptr;
+    int len1 = 0;
+    int len2 = 0;
+    const int32_t bytes_to_get = new_samples_to_get * sizeof(int16_t);
+    int32_t bytes_peeked = rb_peek_at(g_audio_capture_buffer, g_peeked_position,
+                                      &segment1, &len1, &segment2, &len2, bytes_to_get, 10);
+
+    if (bytes_peeked == RB_OVERWRITTEN) {
+        TF_LITE_REPORT_ERROR(error_reporter,
+                             "Audio at %dms was overwritten before it was read, latest is %dms",
+                             static_cast<int32_t>(stride_start_ms),
+                             static_cast<int32_t>(LatestAudioTimestamp()));
+        return kTfLiteError;
+    } else if (bytes_peeked < 0) {
+        TF_LITE_REPORT_ERROR(error_reporter, "Couldn't read audio at %dms from the ring buffer: %d",
+                             static_cast<int32_t>(stride_start_ms), bytes_peeked);
+        return kTfLiteError;
+    } else if (bytes_peeked < bytes_to_get) {
+        // Only audio from before recording started is made up, as silence.
+        TF_LITE_REPORT_ERROR(error_reporter,
+                             "Only %d of %d bytes of audio at %dms were captured, latest is %dms",
+                             bytes_peeked, bytes_to_get, static_cast<int32_t>(stride_start_ms),
+                             static_cast<int32_t>(LatestAudioTimestamp()));
+        return kTfLiteError;
     }
 
-    // copy 320 bytes from output_buff into history
-    memcpy((void*)(g_history_buffer),
-           (void*)(g_audio_output_buffer + new_samples_to_get),
-           history_samples_to_keep * sizeof(int16_t) );
-    *audio_samples_size = kMaxAudioSampleSize;
-    *audio_samples = g_audio_output_buffer;
+    audio_segments->samples[0] = (const int16_t*) segment1;
+    audio_segments->sizes[0] = len1 / sizeof(int16_t);
+    audio_segments->samples[1] = (const int16_t*) segment2;
+    audio_segments->sizes[1] = len2 / sizeof(int16_t);
+    audio_segments->sizes[2] = 0;
     return kTfLiteOk;
 }
 
-int32_t LatestAudioTimestamp() { return g_latest_audio_timestamp; }
+TfLiteStatus ReleaseAudioSamples(tflite::ErrorReporter* error_reporter) {
+    if (!rb_is_intact(g_audio_capture_buffer, g_peeked_position)) {
+        TF_LITE_REPORT_ERROR(error_reporter,
+                             "Audio at %dms was overwritten while it was being used",
+                             static_cast<int32_t>(g_peeked_start_ms));
+        return kTfLiteError;
+    }
+    return kTfLiteOk;
+}
+
+uint64_t LatestAudioSampleCount() {
+    uint32_t sequence;
+    uint64_t samples;
+    do {
+        sequence = __atomic_load_n(&g_captured_samples_sequence, __ATOMIC_SEQ_CST);
+        samples = g_captured_samples;
+    } while ((sequence & 1) ||
+             (sequence != __atomic_load_n(&g_captured_samples_sequence, __ATOMIC_SEQ_CST)));
+    return samples;
+}
+
+int64_t LatestAudioTimestamp() { return LatestAudioSampleCount() / kSamplesPerMs; }
+
+bool WaitForAudioSamples(uint64_t sample_count, TickType_t ticks_to_wait) {
+    const TickType_t start = xTaskGetTickCount();
+    // Register before checking, so a stride completed in between still wakes us.
+    __atomic_store_n(&g_audio_waiter, xTaskGetCurrentTaskHandle(), __ATOMIC_SEQ_CST);
+    bool is_captured;
+    while (!(is_captured = (LatestAudioSampleCount() >= sample_count))) {
+        if (ticks_to_wait == portMAX_DELAY) {
+            ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+            continue;
+        }
+        const TickType_t waited = xTaskGetTickCount() - start;
+        if (waited >= ticks_to_wait) {
+            break;
+        }
+        ulTaskNotifyTake(pdTRUE, ticks_to_wait - waited);
+    }
+    __atomic_store_n(&g_audio_waiter, (TaskHandle_t) nullptr, __ATOMIC_SEQ_CST);
+    return is_captured;
+}
+
+bool WaitForAudio(int64_t time_in_ms, TickType_t ticks_to_wait) {
+    return WaitForAudioSamples(static_cast<uint64_t>(time_in_ms * kSamplesPerMs), ticks_to_wait);
+}
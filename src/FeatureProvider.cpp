@@ -1,89 +1,96 @@
 #include "FeatureProvider.h"
-#include "MicroFeaturesGenerator.h"
-#include "MicroModelSettings.h"
+
 #include "AudioProvider.h"
+#include "Profiler.h"
 
-FeatureProvider::FeatureProvider(int feature_size, int8_t* feature_data)
-    : _feature_size(feature_size),
-      _feature_data(feature_data),
-      _is_first_run(true) {
-    for (int n = 0; n < _feature_size; ++n) {
-        _feature_data[n] = 0;
-    }
-}
+FeatureProvider::FeatureProvider(float input_scale, int32_t input_zero_point)
+    : _generator(input_scale, input_zero_point),
+      _is_first_run(true) {}
 
 FeatureProvider::~FeatureProvider() {}
 
-TfLiteStatus FeatureProvider::PopulateFeatureData(
-    tflite::ErrorReporter *error_reporter, int32_t last_time_in_ms, int32_t time_in_ms, int *how_many_new_slices) {
-    if (_feature_size != kFeatureElementCount) {
-        TF_LITE_REPORT_ERROR(error_reporter,
-                             "Requested _feature_data size %d doesn't match %d",
-                             _feature_size, kFeatureElementCount);
-        return kTfLiteError;
-    }
-
+TfLiteStatus FeatureProvider::NewSteps(
+    tflite::ErrorReporter *error_reporter, int64_t last_time_in_ms, int64_t time_in_ms,
+    int64_t* first_step, int *how_many_new_slices) {
     // Quantize the time into steps as long as each window stride, so we can figure out which audio data we need to fetch
-    const int last_step = (last_time_in_ms / kFeatureSliceStrideMs);
-    const int current_step = (time_in_ms / kFeatureSliceStrideMs);
+    const int64_t last_step = (last_time_in_ms / kFeatureSliceStrideMs);
+    const int64_t current_step = (time_in_ms / kFeatureSliceStrideMs);
 
-    int slices_needed = current_step - last_step;
+    // Clamped while still 64-bit, after a long gap the step count won't fit an int.
+    const int64_t steps_since_last = current_step - last_step;
+    int slices_needed = static_cast<int>(
+        steps_since_last < kFeatureSliceCount ? steps_since_last : kFeatureSliceCount);
     if (_is_first_run) {
-        TfLiteStatus init_status = InitializeMicroFeatures(error_reporter);
+        TfLiteStatus init_status = _generator.Initialize(error_reporter);
         if (init_status != kTfLiteOk) {
             return init_status;
         }
         _is_first_run = false;
         slices_needed = kFeatureSliceCount;
     }
-    if (slices_needed > kFeatureSliceCount) {
-        slices_needed = kFeatureSliceCount;
-    }
 
+    // The newest step is the last one whose stride has been completely captured.
+    *first_step = current_step - slices_needed;
     *how_many_new_slices = slices_needed;
+    return kTfLiteOk;
+}
 
-    const int slices_to_keep = kFeatureSliceCount - slices_needed;
-    const int slices_to_drop = kFeatureSliceCount - slices_to_keep;
+TfLiteStatus FeatureProvider::GenerateFeatureSlices(
+    tflite::ErrorReporter* error_reporter, int64_t first_step, int slice_count, int8_t* slice_data) {
+    while (slice_count > 0) {
+        // Audio from before recording started is all silence, so don't mix those steps
+        // with later ones in one fetch.
+        int burst_count = slice_count;
+        if ((first_step < 0) && (first_step + burst_count > 0)) {
+            burst_count = static_cast<int>(-first_step);
+        }
 
-    if (slices_to_keep > 0) {
-        for (int dest_slice = 0; dest_slice < slices_to_keep; ++dest_slice) {
-            int8_t* dest_slice_data =
-                _feature_data + (dest_slice * kFeatureSliceSize);
-            const int src_slice = dest_slice + slices_to_drop;
-            const int8_t* src_slice_data =
-                _feature_data + (src_slice * kFeatureSliceSize);
-            for (int i = 0; i < kFeatureSliceSize; ++i) {
-                dest_slice_data[i] = src_slice_data[i];
-            }
+        // Step n's new audio is the stride starting at n * kFeatureSliceStrideMs, and its
+        // window reaches back over the previous stride.
+        const int64_t slice_start_ms = (first_step * kFeatureSliceStrideMs) -
+            (kFeatureSliceDurationMs - kFeatureSliceStrideMs);
+        const int duration_ms = kFeatureSliceDurationMs + ((burst_count - 1) * kFeatureSliceStrideMs);
+        AudioSegments audio_segments;
+        uint32_t fetch_start = ProfileNow();
+        TfLiteStatus audio_status = GetAudioSamples(
+            error_reporter, slice_start_ms, duration_ms, &audio_segments);
+        ProfileRecord(kProfileAudioFetch, fetch_start);
+        if (audio_status != kTfLiteOk) {
+            return audio_status;
         }
-    }
 
-    if (slices_needed > 0) {
-        for (int new_slice = slices_to_keep; new_slice < kFeatureSliceCount; ++new_slice) {
-            const int new_step = (current_step - kFeatureSliceCount + 1) + new_slice;
-            const int32_t slice_start_ms = (new_step * kFeatureSliceStrideMs);
-            int16_t* audio_samples = nullptr;
-            int audio_samples_size = 0;
-            GetAudioSamples(error_reporter, (slice_start_ms > 0 ? slice_start_ms : 0),
-                            kFeatureSliceDurationMs, &audio_samples_size,
-                            &audio_samples);
-            if (audio_samples_size < kMaxAudioSampleSize) {
-                TF_LITE_REPORT_ERROR(error_reporter,
-                                     "Audio data size %d too small, want %d",
-                                     audio_samples_size, kMaxAudioSampleSize);
-                return kTfLiteError;
+        uint32_t generate_start = ProfileNow();
+        int slices_generated = 0;
+        for (int segment = 0; segment < kMaxAudioSegments; ++segment) {
+            if (audio_segments.sizes[segment] == 0) {
+                continue;
             }
-
-            int8_t* new_slice_data = _feature_data + (new_slice * kFeatureSliceSize);
-            size_t num_samples_read;
-            TfLiteStatus generate_status = GenerateMicroFeatures(
-                error_reporter, audio_samples, audio_samples_size, kFeatureSliceSize,
-                new_slice_data, &num_samples_read
+            int slices_written;
+            TfLiteStatus generate_status = _generator.Generate(
+                error_reporter, audio_segments.samples[segment], audio_segments.sizes[segment],
+                burst_count - slices_generated, slice_data + (slices_generated * kFeatureSliceSize),
+                &slices_written
                                                                  );
             if (generate_status != kTfLiteOk) {
+                ReleaseAudioSamples(error_reporter);
                 return generate_status;
             }
+            slices_generated += slices_written;
+        }
+        ProfileRecord(kProfileFeatureGeneration, generate_start);
+        TfLiteStatus release_status = ReleaseAudioSamples(error_reporter);
+        if (release_status != kTfLiteOk) {
+            return release_status;
         }
+        if (slices_generated != burst_count) {
+            TF_LITE_REPORT_ERROR(error_reporter, "Got %d slices from %d strides of audio",
+                                 slices_generated, burst_count);
+            return kTfLiteError;
+        }
+
+        first_step += burst_count;
+        slice_count -= burst_count;
+        slice_data += burst_count * kFeatureSliceSize;
     }
     return kTfLiteOk;
 }
@@ -0,0 +1,32 @@
+#include "FeatureWindow.h"
+
+#include <algorithm>
+#include <cstring>
+
+#include "MicroModelSettings.h"
+
+FeatureWindow::FeatureWindow(int feature_size, int8_t* feature_data)
+    : _feature_size(feature_size),
+      _feature_data(feature_data),
+      _slice_size(kFeatureSliceSize),
+      _slice_count(feature_size / kFeatureSliceSize),
+      _head_slice(0) {
+    for (int n = 0; n < _feature_size; ++n) {
+        _feature_data[n] = 0;
+    }
+}
+
+void FeatureWindow::CommitSlice() {
+    _head_slice = (_head_slice + 1) % _slice_count;
+}
+
+void FeatureWindow::LinearizeFeatureData(int8_t* dest) {
+    const int head_offset = _head_slice * _slice_size;
+    if (dest == _feature_data) {
+        std::rotate(_feature_data, _feature_data + head_offset, _feature_data + _feature_size);
+        _head_slice = 0;
+        return;
+    }
+    memcpy(dest, _feature_data + head_offset, _feature_size - head_offset);
+    memcpy(dest + (_feature_size - head_offset), _feature_data, head_offset);
+}
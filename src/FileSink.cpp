@@ -0,0 +1,49 @@
+#include "FileSink.h"
+
+#include "esp_log.h"
+
+static const char* TAG = "FILE_SINK";
+
+FileSink::FileSink() : _file(nullptr), _samples_left(0) {}
+
+FileSink::~FileSink() {
+    if (_file) {
+        fclose(_file);
+    }
+}
+
+bool FileSink::Open(const char* path, uint32_t max_samples) {
+    if (_file) {
+        ESP_LOGE(TAG, "Already recording");
+        return false;
+    }
+    FILE* file = fopen(path, "wb");
+    if (!file) {
+        ESP_LOGE(TAG, "Couldn't open %s", path);
+        return false;
+    }
+    _samples_left = max_samples;
+    // The capture task starts writing as soon as it sees the file.
+    __atomic_store_n(&_file, file, __ATOMIC_RELEASE);
+    return true;
+}
+
+void FileSink::WriteSamples(const int16_t* samples, size_t count) {
+    FILE* file = __atomic_load_n(&_file, __ATOMIC_ACQUIRE);
+    if (!file) {
+        return;
+    }
+    if (count > _samples_left) {
+        count = _samples_left;
+    }
+    if (fwrite(samples, sizeof(int16_t), count, file) != count) {
+        ESP_LOGE(TAG, "Error writing audio, stopping");
+        _samples_left = 0;
+    } else {
+        _samples_left -= count;
+    }
+    if (_samples_left == 0) {
+        fclose(file);
+        __atomic_store_n(&_file, (FILE*) nullptr, __ATOMIC_RELEASE);
+    }
+}
@@ -0,0 +1,67 @@
+#include "InferenceScheduler.h"
+
+#include <algorithm>
+#include <cstdlib>
+
+InferenceScheduler::InferenceScheduler(int32_t active_stride_ms,
+                                       int32_t stable_stride_ms,
+                                       uint8_t uncertainty_margin)
+    : _active_stride_slices(active_stride_ms / kFeatureSliceStrideMs),
+      _stable_stride_slices(stable_stride_ms / kFeatureSliceStrideMs),
+      _uncertainty_margin(uncertainty_margin),
+      _every_slice(false),
+      _pending_slices(0),
+      _reported_slices(0),
+      _reported_invokes(0) {
+    if (_active_stride_slices < 1) {
+        _active_stride_slices = 1;
+    }
+    if (_stable_stride_slices < _active_stride_slices) {
+        _stable_stride_slices = _active_stride_slices;
+    }
+    // Start out active until the first results come in.
+    _stride_slices = _active_stride_slices;
+}
+
+bool InferenceScheduler::ShouldInvoke(int new_slices) {
+    _pending_slices += new_slices;
+    _reported_slices += new_slices;
+    if (!_every_slice && (_pending_slices < _stride_slices)) {
+        return false;
+    }
+    _pending_slices = 0;
+    _reported_invokes += 1;
+    return true;
+}
+
+void InferenceScheduler::UpdateResults(uint8_t score, uint8_t detection_threshold,
+                                       bool is_new_level) {
+    // RecognizeLevels scores 0 until it has enough results to average, which says
+    // nothing about whether the state is stable, so stay on the current stride.
+    if ((score == 0) && !is_new_level) {
+        return;
+    }
+    int margin = _uncertainty_margin;
+    if (score > detection_threshold) {
+        margin = std::min(margin, (255 - detection_threshold) / 2);
+    }
+    const bool is_uncertain = abs(score - detection_threshold) < margin;
+    if (is_new_level || is_uncertain) {
+        _stride_slices = _active_stride_slices;
+    } else {
+        _stride_slices = _stable_stride_slices;
+    }
+}
+
+void InferenceScheduler::ReportInferenceRate(tflite::ErrorReporter* error_reporter) {
+    if (_reported_slices == 0) {
+        return;
+    }
+    // Invokes per second of audio in tenths, the error reporter can't print floats.
+    const int32_t audio_ms = _reported_slices * kFeatureSliceStrideMs;
+    const int32_t rate_tenths = (_reported_invokes * 10000) / audio_ms;
+    TF_LITE_REPORT_ERROR(error_reporter, "inference rate: %d.%d/s (%d of %d slices)",
+                         rate_tenths / 10, rate_tenths % 10, _reported_invokes, _reported_slices);
+    _reported_slices = 0;
+    _reported_invokes = 0;
+}
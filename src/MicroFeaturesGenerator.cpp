@@ -1,17 +1,79 @@
 #include "MicroFeaturesGenerator.h"
 
-#include "tensorflow/lite/experimental/microfrontend/lib/frontend.h"
 #include "tensorflow/lite/experimental/microfrontend/lib/frontend_util.h"
 #include "MicroModelSettings.h"
 
 #define FIXED_POINT 16
 
 namespace {
-    FrontendState g_micro_features_state;
-    bool g_is_first_time = true;
+    // Features are quantized through a table with the value for each frontend output.
+    // Outputs go up to about 670, anything past the end of the table is saturated anyway.
+    constexpr int32_t RoundFeature(float value) {
+        return static_cast<int32_t>(value + 0.5f);
+    }
+
+    constexpr int8_t ClampFeature(int32_t value) {
+        return (value > 127) ? 127 : ((value < -128) ? -128 : static_cast<int8_t>(value));
+    }
+
+    // step is the frontend output per step of the input, the training divisor times the
+    // input scale.
+    constexpr int8_t QuantizeFeature(int32_t feature, float step, int32_t zero_point) {
+        return ClampFeature(RoundFeature(feature / step) + zero_point);
+    }
+
+    // Up to the first output that quantizes past 127, the last entry needed.
+    constexpr int FeatureTableSize(float step, int32_t zero_point) {
+        return static_cast<int>((127.5f - zero_point) * step) + 2;
+    }
+
+    // Longest table built at runtime. The frontend's log scaled output stays well below.
+    constexpr int kMaxFeatureTableSize = 2048;
+
+    // The table for the quantization in MicroModelSettings.h is worked out at compile time.
+    constexpr float kFeatureStep = kFeatureInputDivisor * kModelInputScale;
+    constexpr int kFeatureTableSize = FeatureTableSize(kFeatureStep, kModelInputZeroPoint);
+
+    // A list of 0 to N - 1 to expand the table from, built by halves to keep the
+    // template recursion shallow.
+    template <int... I> struct Indices {};
+    template <class A, class B> struct ConcatIndices;
+    template <int... A, int... B> struct ConcatIndices<Indices<A...>, Indices<B...>> {
+        typedef Indices<A..., (static_cast<int>(sizeof...(A)) + B)...> type;
+    };
+    template <int N> struct MakeIndices {
+        typedef typename ConcatIndices<typename MakeIndices<N / 2>::type,
+                                       typename MakeIndices<N - (N / 2)>::type>::type type;
+    };
+    template <> struct MakeIndices<0> { typedef Indices<> type; };
+    template <> struct MakeIndices<1> { typedef Indices<0> type; };
+
+    struct FeatureTable {
+        int8_t values[kFeatureTableSize];
+    };
+
+    template <int... I>
+    constexpr FeatureTable MakeFeatureTable(Indices<I...>) {
+        return FeatureTable{{QuantizeFeature(I, kFeatureStep, kModelInputZeroPoint)...}};
+    }
+
+    constexpr FeatureTable kFeatureTable = MakeFeatureTable(MakeIndices<kFeatureTableSize>::type());
+
+    static_assert(QuantizeFeature(0, kFeatureStep, kModelInputZeroPoint) == kModelInputZeroPoint,
+                  "Silence should quantize to the zero point");
+    static_assert(QuantizeFeature(kFeatureTableSize - 1, kFeatureStep, kModelInputZeroPoint) == 127,
+                  "The table should end saturated");
+
+    void QuantizeFeatures(const FrontendOutput& frontend_output, const int8_t* table, int table_size,
+                          int8_t* output) {
+        for (size_t i = 0; i < frontend_output.size; ++i) {
+            const uint16_t feature = frontend_output.values[i];
+            output[i] = table[(feature < table_size) ? feature : (table_size - 1)];
+        }
+    }
 }
 
-TfLiteStatus InitializeMicroFeatures(tflite::ErrorReporter* error_reporter) {
+FrontendConfig MicroFeaturesGenerator::DefaultConfig() {
     FrontendConfig config;
     config.window.size_ms = kFeatureSliceDurationMs;
     config.window.step_size_ms = kFeatureSliceStrideMs;
@@ -28,56 +90,100 @@ TfLiteStatus InitializeMicroFeatures(tflite::ErrorReporter* error_reporter) {
     config.pcan_gain_control.gain_bits = 21;
     config.log_scale.enable_log = 1;
     config.log_scale.scale_shift = 6;
+    return config;
+}
 
-    if (!FrontendPopulateState(&config, &g_micro_features_state, kAudioSampleFrequency)) {
-        TF_LITE_REPORT_ERROR(error_reporter, "FrontendPopulateState() failed");
+MicroFeaturesGenerator::MicroFeaturesGenerator(float input_scale, int32_t input_zero_point,
+                                               const FrontendConfig& config)
+    : _config(config),
+      _is_initialized(false),
+      _input_scale(input_scale),
+      _input_zero_point(input_zero_point),
+      _table(nullptr),
+      _table_size(0),
+      _runtime_table(nullptr) {}
+
+MicroFeaturesGenerator::~MicroFeaturesGenerator() {
+    if (_is_initialized) {
+        FrontendFreeStateContents(&_state);
+    }
+    delete[] _runtime_table;
+}
+
+TfLiteStatus MicroFeaturesGenerator::BuildFeatureTable(tflite::ErrorReporter* error_reporter) {
+    if ((_input_scale == kModelInputScale) && (_input_zero_point == kModelInputZeroPoint)) {
+        _table = kFeatureTable.values;
+        _table_size = kFeatureTableSize;
+        return kTfLiteOk;
+    }
+
+    const float step = kFeatureInputDivisor * _input_scale;
+    if ((_input_scale <= 0.0f) || (_input_zero_point < -128) || (_input_zero_point > 127) ||
+        (FeatureTableSize(step, _input_zero_point) > kMaxFeatureTableSize)) {
+        TF_LITE_REPORT_ERROR(error_reporter, "Can't quantize features with scale %f and zero point %d",
+                             _input_scale, _input_zero_point);
         return kTfLiteError;
     }
-    g_is_first_time = true;
+    TF_LITE_REPORT_ERROR(error_reporter, "Model input quantization isn't the one in MicroModelSettings.h, "
+                         "building the feature table at runtime");
+    _table_size = FeatureTableSize(step, _input_zero_point);
+    _runtime_table = new int8_t[_table_size];
+    for (int feature = 0; feature < _table_size; ++feature) {
+        _runtime_table[feature] = QuantizeFeature(feature, step, _input_zero_point);
+    }
+    _table = _runtime_table;
     return kTfLiteOk;
 }
 
-TfLiteStatus GenerateMicroFeatures(tflite::ErrorReporter* error_reporter,
-                                   const int16_t* input, int input_size,
-                                   int output_size, int8_t* output,
-                                   size_t* num_samples_read) {
-    const int16_t* frontend_input;
-    if (g_is_first_time) {
-        frontend_input = input;
-        g_is_first_time = false;
-    } else {
-        frontend_input = input + 160;
+TfLiteStatus MicroFeaturesGenerator::Initialize(tflite::ErrorReporter* error_reporter) {
+    if (_is_initialized) {
+        FrontendFreeStateContents(&_state);
+        _is_initialized = false;
     }
+    if (!_table) {
+        TfLiteStatus table_status = BuildFeatureTable(error_reporter);
+        if (table_status != kTfLiteOk) {
+            return table_status;
+        }
+    }
+    if (!FrontendPopulateState(&_config, &_state, kAudioSampleFrequency)) {
+        TF_LITE_REPORT_ERROR(error_reporter, "FrontendPopulateState() failed");
+        return kTfLiteError;
+    }
+    _is_initialized = true;
 
-    FrontendOutput frontend_output = FrontendProcessSamples(
-        &g_micro_features_state, frontend_input, input_size, num_samples_read
-                                                            );
-
-    for (size_t i = 0; i < frontend_output.size; ++i) {
-        // These scaling values are derived from those used in input_data.py in the training pipeline
-        // The feature pipeline outputs 16-bit signed integers in rougly a 0 to 670 range. In training,
-        // these are then arbitrarily divided by 25.6 to get float values in the rough range of 0.0 to 26.0
-        // This scaling is performed for historical reasons, to match up with the output of other feature
-        // generators.
-        // The process is then further complicated when we quantize the model. This means we have to scale the
-        // 0.0 to 26.0 real values to the -12 to 127 signed integer numbers.
-        // All this means that to get matching values from our integer feature output into the tensor input
-        // we have to perform:
-        // input = (((feature / 25.6) / 26.0) * 256) - 128
-        // To simplify this and perform it in 32-bit integer math, we rearrange to:
-        // input = (feature * 256) / (25.6*26.0) - 128
-        constexpr int32_t value_scale = 256;
-        constexpr int32_t value_div = static_cast<int32_t>((5.6f * 26.0f) + 0.5f);
-        int32_t value = ((frontend_output.values[i] * value_scale) + (value_div / 2)) / value_div;
-        value -= 128;
-        if (value < -128) {
-            value = -128;
+    // Each window overlaps the previous stride, and the frontend keeps that overlap
+    // itself. There is no audio before the first stride, so start it off with silence.
+    const int16_t history[kFeatureSliceHistorySamples] = {};
+    size_t num_samples_read;
+    FrontendProcessSamples(&_state, history, kFeatureSliceHistorySamples, &num_samples_read);
+    return kTfLiteOk;
+}
+
+TfLiteStatus MicroFeaturesGenerator::Generate(tflite::ErrorReporter* error_reporter,
+                                              const int16_t* input, int input_size,
+                                              int max_slices, int8_t* output,
+                                              int* slices_written) {
+    *slices_written = 0;
+    // The frontend stops after each window it completes, so keep going until all of
+    // the input has been used.
+    while (input_size > 0) {
+        size_t num_samples_read;
+        FrontendOutput frontend_output = FrontendProcessSamples(
+            &_state, input, input_size, &num_samples_read
+                                                                );
+        input += num_samples_read;
+        input_size -= num_samples_read;
+        if (frontend_output.size == 0) {
+            continue;
         }
-        if (value > 127) {
-            value = 127;
+        if (*slices_written >= max_slices) {
+            TF_LITE_REPORT_ERROR(error_reporter, "Audio for more than %d slices", max_slices);
+            return kTfLiteError;
         }
-        output[i] = value;
+        QuantizeFeatures(frontend_output, _table, _table_size, output);
+        output += kFeatureSliceSize;
+        ++*slices_written;
     }
-
     return kTfLiteOk;
 }
@@ -0,0 +1,96 @@
+#include "ModelLoader.h"
+
+#include "esp_partition.h"
+#include "model.h"
+#include "tensorflow/lite/schema/schema_generated.h"
+
+const char* const kModelPartitionLabels[kModelSlotCount] = {"model0", "model1"};
+
+namespace {
+    spi_flash_mmap_handle_t g_model_mmap_handles[kModelSlotCount];
+    bool g_is_model_mapped[kModelSlotCount] = {};
+}
+
+bool IsValidModel(tflite::ErrorReporter* error_reporter, const uint8_t* data, size_t size) {
+    // Erased flash is all 0xff, so most invalid partitions fail on the identifier.
+    if ((size < 8) || !tflite::ModelBufferHasIdentifier(data)) {
+        TF_LITE_REPORT_ERROR(error_reporter, "No TFLite model identifier");
+        return false;
+    }
+    flatbuffers::Verifier verifier(data, size);
+    if (!tflite::VerifyModelBuffer(verifier)) {
+        TF_LITE_REPORT_ERROR(error_reporter, "Model flatbuffer is corrupt");
+        return false;
+    }
+    const tflite::Model* model = tflite::GetModel(data);
+    if (model->version() != TFLITE_SCHEMA_VERSION) {
+        TF_LITE_REPORT_ERROR(error_reporter,
+                             "Model provided is schema version %d not equal "
+                             "to supported version %d.",
+                             model->version(), TFLITE_SCHEMA_VERSION);
+        return false;
+    }
+    return true;
+}
+
+const uint8_t* LoadModelSlot(tflite::ErrorReporter* error_reporter, int slot, size_t* model_size) {
+    if (slot == kBuiltInModelSlot) {
+        if (!IsValidModel(error_reporter, g_model, g_model_len)) {
+            return nullptr;
+        }
+        *model_size = g_model_len;
+        return g_model;
+    }
+    if ((slot < 0) || (slot >= kModelSlotCount)) {
+        TF_LITE_REPORT_ERROR(error_reporter, "No model slot %d", slot);
+        return nullptr;
+    }
+
+    const esp_partition_t* partition = esp_partition_find_first(
+        ESP_PARTITION_TYPE_DATA, (esp_partition_subtype_t) kModelPartitionSubtype,
+        kModelPartitionLabels[slot]);
+    if (!partition) {
+        TF_LITE_REPORT_ERROR(error_reporter, "No %s partition", kModelPartitionLabels[slot]);
+        return nullptr;
+    }
+    // A mapped slot may be in use, it has to be unloaded before it is loaded again.
+    if (g_is_model_mapped[slot]) {
+        TF_LITE_REPORT_ERROR(error_reporter, "The %s partition is already loaded", kModelPartitionLabels[slot]);
+        return nullptr;
+    }
+    const void* data = nullptr;
+    if (esp_partition_mmap(partition, 0, partition->size, SPI_FLASH_MMAP_DATA,
+                           &data, &g_model_mmap_handles[slot]) != ESP_OK) {
+        TF_LITE_REPORT_ERROR(error_reporter, "Couldn't map the %s partition", kModelPartitionLabels[slot]);
+        return nullptr;
+    }
+    g_is_model_mapped[slot] = true;
+    if (!IsValidModel(error_reporter, (const uint8_t*) data, partition->size)) {
+        UnloadModelSlot(slot);
+        return nullptr;
+    }
+    // Flatbuffers don't record their size, the partition bounds it.
+    *model_size = partition->size;
+    return (const uint8_t*) data;
+}
+
+void UnloadModelSlot(int slot) {
+    if ((slot < 0) || (slot >= kModelSlotCount) || !g_is_model_mapped[slot]) {
+        return;
+    }
+    spi_flash_munmap(g_model_mmap_handles[slot]);
+    g_is_model_mapped[slot] = false;
+}
+
+const uint8_t* LoadModel(tflite::ErrorReporter* error_reporter, int* slot, size_t* model_size) {
+    for (int i = 0; i < kModelSlotCount; ++i) {
+        const uint8_t* data = LoadModelSlot(error_reporter, i, model_size);
+        if (data) {
+            TF_LITE_REPORT_ERROR(error_reporter, "Using the model in %s", kModelPartitionLabels[i]);
+            *slot = i;
+            return data;
+        }
+    }
+    *slot = kBuiltInModelSlot;
+    return LoadModelSlot(error_reporter, kBuiltInModelSlot, model_size);
+}
@@ -0,0 +1,62 @@
+#include "Profiler.h"
+
+namespace {
+    StageProfile g_stage_profiles[kProfileStageCount];
+
+    const char* kStageNames[kProfileStageCount] = {
+        "audio fetch",
+        "features",
+        "feature copy",
+        "invoke",
+        "postprocess",
+    };
+
+#if defined(__XTENSA__) || defined(__x86_64__) || defined(__i386__)
+    const char* kTickUnits = "cycles";
+#else
+    const char* kTickUnits = "ns";
+#endif
+}
+
+void ProfileRecord(ProfileStage stage, uint32_t start_ticks) {
+    // Unsigned subtraction keeps the duration right across a counter wrap.
+    const uint32_t duration = ProfileNow() - start_ticks;
+    StageProfile& profile = g_stage_profiles[stage];
+    if ((profile.count == 0) || (duration < profile.min)) {
+        profile.min = duration;
+    }
+    if (duration > profile.max) {
+        profile.max = duration;
+    }
+    profile.count += 1;
+    profile.total += duration;
+    const int bucket = 31 - __builtin_clz(duration | 1);
+    profile.histogram[bucket] += 1;
+}
+
+const StageProfile& GetStageProfile(ProfileStage stage) {
+    return g_stage_profiles[stage];
+}
+
+void ResetStageProfiles() {
+    for (int stage = 0; stage < kProfileStageCount; ++stage) {
+        g_stage_profiles[stage] = StageProfile();
+    }
+}
+
+void ReportStageProfiles(tflite::ErrorReporter* error_reporter) {
+    for (int stage = 0; stage < kProfileStageCount; ++stage) {
+        const StageProfile& profile = g_stage_profiles[stage];
+        if (profile.count == 0) {
+            continue;
+        }
+        TF_LITE_REPORT_ERROR(error_reporter, "%s: n=%d min=%d max=%d mean=%d %s",
+                             kStageNames[stage], profile.count, profile.min, profile.max,
+                             static_cast<uint32_t>(profile.total / profile.count), kTickUnits);
+        for (int bucket = 0; bucket < kProfileHistogramBuckets; ++bucket) {
+            if (profile.histogram[bucket] > 0) {
+                TF_LITE_REPORT_ERROR(error_reporter, "  >= 2^%d: %d", bucket, profile.histogram[bucket]);
+            }
+        }
+    }
+}
@@ -1,7 +1,44 @@
 #include "RecognizeLevels.h"
 
+#include <algorithm>
 #include <limits>
 
+namespace {
+    // exp(-i / kExpTableStepsPerLogit) in Q15, for the softmax of averaged logits.
+    // Beyond the table the terms are too small to change the score.
+    constexpr int kExpTableStepsPerLogit = 16;
+    constexpr int kExpTableSize = 160;
+    constexpr uint16_t kExpTable[kExpTableSize] = {
+        32768, 30783, 28918, 27166, 25520, 23974, 22521, 21157, 19875, 18671, 17539, 16477,
+        15479, 14541, 13660, 12832, 12055, 11324, 10638, 9994, 9388, 8819, 8285, 7783,
+        7312, 6869, 6452, 6061, 5694, 5349, 5025, 4721, 4435, 4166, 3914, 3676,
+        3454, 3244, 3048, 2863, 2690, 2527, 2374, 2230, 2095, 1968, 1849, 1737,
+        1631, 1533, 1440, 1352, 1271, 1194, 1121, 1053, 990, 930, 873, 820,
+        771, 724, 680, 639, 600, 564, 530, 498, 467, 439, 412, 387,
+        364, 342, 321, 302, 283, 266, 250, 235, 221, 207, 195, 183,
+        172, 162, 152, 143, 134, 126, 118, 111, 104, 98, 92, 86,
+        81, 76, 72, 67, 63, 59, 56, 52, 49, 46, 43, 41,
+        38, 36, 34, 32, 30, 28, 26, 25, 23, 22, 21, 19,
+        18, 17, 16, 15, 14, 13, 12, 12, 11, 10, 10, 9,
+        9, 8, 8, 7, 7, 6, 6, 6, 5, 5, 5, 4,
+        4, 4, 4, 3, 3, 3, 3, 3, 2, 2, 2, 2,
+        2, 2, 2, 2,
+    };
+
+    // The score of a top level margin_steps kExpTable steps above the runner-up, when
+    // there are only the two: their softmax.
+    int32_t TwoLevelScore(int64_t margin_steps) {
+        const uint32_t runner_up = (margin_steps < kExpTableSize) ? kExpTable[margin_steps] : 0;
+        return std::min<int32_t>(255, (256 * 32768) / (32768 + runner_up));
+    }
+
+    // An int8 softmax output is always quantized with this scale and zero point,
+    // anything else is taken to be the logits of a model exported without the Softmax.
+    bool IsLogitsOutput(const TfLiteTensor* results) {
+        return (results->params.scale != 1.0f / 256) || (results->params.zero_point != -128);
+    }
+}
+
 RecognizeLevels::RecognizeLevels(tflite::ErrorReporter* error_reporter,
                                  int32_t average_window_duration_ms,
                                  uint8_t detection_threshold,
@@ -12,13 +49,27 @@ RecognizeLevels::RecognizeLevels(tflite::ErrorReporter* error_reporter,
       _detection_threshold(detection_threshold),
       _suppression_ms(suppression_ms),
       _minimum_count(minimum_count),
-      _previous_results(error_reporter) {
+      // At most one result per slice fits in the window, counting both its ends.
+      _previous_results(error_reporter, (average_window_duration_ms / kFeatureSliceStrideMs) + 1),
+      _logits_scale(0),
+      _logits_multiplier(0) {
+    // The logit margin over the runner-up beyond which a level counts as detected.
+    _threshold_steps = 0;
+    while ((_threshold_steps < kExpTableSize) && (TwoLevelScore(_threshold_steps) <= detection_threshold)) {
+        ++_threshold_steps;
+    }
+    _previous_top_label = PowerLevel::NONE;
+    _previous_top_label_time = std::numeric_limits<int64_t>::min();
+}
+
+void RecognizeLevels::Reset() {
+    _previous_results.clear();
     _previous_top_label = PowerLevel::NONE;
-    _previous_top_label_time = std::numeric_limits<int32_t>::min();
+    _previous_top_label_time = std::numeric_limits<int64_t>::min();
 }
 
 TfLiteStatus RecognizeLevels::ProcessLatestResults(
-    const TfLiteTensor* latest_results, const int32_t current_time_ms,
+    const TfLiteTensor* latest_results, const int64_t current_time_ms,
     PowerLevel* level, uint8_t* score, bool* is_new_command) {
     if ((latest_results->dims->size != 2) ||
         (latest_results->dims->data[0] != 1) ||
@@ -46,15 +97,14 @@ TfLiteStatus RecognizeLevels::ProcessLatestResults(
             _error_reporter,
             "Results must be fed in increasing time order, but received a "
             "timestamp of %d that was earlier than the previous one of %d",
-            current_time_ms, _previous_results.front().time_
+            static_cast<int32_t>(current_time_ms),
+            static_cast<int32_t>(_previous_results.front().time_)
                              );
         return kTfLiteError;
     }
 
-    //TF_LITE_REPORT_ERROR(_error_reporter, "pushback");
-    _previous_results.push_back({current_time_ms, latest_results->data.int8});
-
-    // Prune any earlier results that are too old for the averaging window.
+    // Prune any earlier results that are too old for the averaging window, before
+    // adding the latest so it fits in a queue sized for the window.
     const int64_t time_limit = current_time_ms - _average_window_duration_ms;
     //TF_LITE_REPORT_ERROR(_error_reporter, "pop_front");
     while ((!_previous_results.empty()) &&
@@ -62,6 +112,9 @@ TfLiteStatus RecognizeLevels::ProcessLatestResults(
         _previous_results.pop_front();
     }
 
+    //TF_LITE_REPORT_ERROR(_error_reporter, "pushback");
+    _previous_results.push_back({current_time_ms, latest_results->data.int8});
+
     // If there are too few results, assume the result will be unreliable and bail
     const int64_t how_many_results = _previous_results.size();
     const int64_t earliest_time = _previous_results.front().time_;
@@ -79,34 +132,46 @@ TfLiteStatus RecognizeLevels::ProcessLatestResults(
         return kTfLiteOk;
     }
 
-    // calculate the average score across all the results in the window.
-    int32_t average_scores[kCategoryCount];
-    //TF_LITE_REPORT_ERROR(_error_reporter, "calculate average scores");
-    for (int offset = 0; offset < _previous_results.size(); ++offset) {
-        PreviousResultsQueue::Result previous_result =
-            _previous_results.from_front(offset);
-        const int8_t* scores = previous_result.scores;
-        for (int i = 0; i < kCategoryCount; ++i) {
-            if (offset == 0) {
-                average_scores[i] = scores[i] + 128;
-            } else {
-                average_scores[i] += scores[i] + 128;
-            }
-        }
-    }
-    for (int i = 0; i < kCategoryCount; ++i) {
-        average_scores[i] /= how_many_results;
-    }
+    // The scores summed across all the results in the window.
+    const int32_t* score_sums = _previous_results.sums();
 
     // Find the current highest scoring category.
     int current_top_index = 0;
     int32_t current_top_score = 0;
+    bool is_above_threshold = false;
+    const bool is_logits_output = IsLogitsOutput(latest_results);
     //TF_LITE_REPORT_ERROR(_error_reporter, "find current top");
-    for (int i = 0; i < kCategoryCount; ++i) {
-        if (average_scores[i] > current_top_score) {
-            current_top_score = average_scores[i];
-            current_top_index = i;
+    if (is_logits_output) {
+        // Thresholded on the top level's margin over the runner-up, in the logit domain.
+        // Only a reported level gets the softmax over all of them as its score, the
+        // scheduler's is the margin's two-level score.
+        int runner_up_index = 1;
+        if (score_sums[1] > score_sums[0]) {
+            current_top_index = 1;
+            runner_up_index = 0;
+        }
+        for (int i = 2; i < kCategoryCount; ++i) {
+            if (score_sums[i] > score_sums[current_top_index]) {
+                runner_up_index = current_top_index;
+                current_top_index = i;
+            } else if (score_sums[i] > score_sums[runner_up_index]) {
+                runner_up_index = i;
+            }
+        }
+        const int64_t margin_steps = LogitSteps(score_sums[current_top_index] - score_sums[runner_up_index],
+                                                how_many_results, latest_results->params.scale);
+        is_above_threshold = margin_steps >= _threshold_steps;
+        current_top_score = TwoLevelScore(margin_steps);
+    } else {
+        // The softmax outputs are offset by 128.
+        for (int i = 0; i < kCategoryCount; ++i) {
+            const int32_t average_score = (score_sums[i] + 128 * how_many_results) / how_many_results;
+            if (average_score > current_top_score) {
+                current_top_score = average_score;
+                current_top_index = i;
+            }
         }
+        is_above_threshold = current_top_score > _detection_threshold;
     }
 
     //TF_LITE_REPORT_ERROR(_error_reporter, "convert to label: %d", current_top_index);
@@ -116,19 +181,23 @@ TfLiteStatus RecognizeLevels::ProcessLatestResults(
     //TF_LITE_REPORT_ERROR(_error_reporter, "check how recently we got a result");
     int64_t time_since_last_top;
     if ((_previous_top_label == kCategoryLabels[0]) ||
-        (_previous_top_label_time == std::numeric_limits<int32_t>::min())) {
-        time_since_last_top = std::numeric_limits<int32_t>::max();
+        (_previous_top_label_time == std::numeric_limits<int64_t>::min())) {
+        time_since_last_top = std::numeric_limits<int64_t>::max();
     } else {
         time_since_last_top = current_time_ms - _previous_top_label_time;
     }
 
     //TF_LITE_REPORT_ERROR(_error_reporter, "assign is_new_command");
-    if ((current_top_score > _detection_threshold) &&
+    if (is_above_threshold &&
         ((current_top_label != _previous_top_label) ||
          (time_since_last_top > _suppression_ms))) {
         _previous_top_label = current_top_label;
         _previous_top_label_time = current_time_ms;
         *is_new_command = true;
+        if (is_logits_output) {
+            current_top_score = LogitsScore(score_sums, current_top_index, how_many_results,
+                                            latest_results->params.scale);
+        }
     } else {
         *is_new_command = false;
     }
@@ -139,3 +208,26 @@ TfLiteStatus RecognizeLevels::ProcessLatestResults(
 
     return kTfLiteOk;
 }
+
+int64_t RecognizeLevels::LogitSteps(int32_t logit_sum_difference, int count, float scale) {
+    if (scale != _logits_scale) {
+        // Turns a difference of summed quantized logits into kExpTable steps, in Q16.
+        _logits_scale = scale;
+        _logits_multiplier = static_cast<int64_t>(scale * kExpTableStepsPerLogit * 65536.0f + 0.5f);
+    }
+    return ((logit_sum_difference * _logits_multiplier) / count) >> 16;
+}
+
+int32_t RecognizeLevels::LogitsScore(const int32_t* logit_sums, int top_index, int count,
+                                     float scale) {
+    // The softmax of the top category over the averaged logits, in the 0-255 range
+    // the int8 softmax outputs are averaged to. The zero points cancel out.
+    uint32_t exp_sum = 0;
+    for (int i = 0; i < kCategoryCount; ++i) {
+        const int64_t steps = LogitSteps(logit_sums[top_index] - logit_sums[i], count, scale);
+        if (steps < kExpTableSize) {
+            exp_sum += kExpTable[steps];
+        }
+    }
+    return std::min<int32_t>(255, (256 * 32768) / exp_sum);
+}
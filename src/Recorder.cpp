@@ -1,40 +1,10 @@
 #include "Recorder.h"
-#include <Arduino.h>
 
-void Recorder::addSample(int16_t sample) {
-    // add the sample to the current audio buffer
-    currentAudioBuffer[audioBufferPos++] = sample;
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
 
-    if (audioBufferPos == bufferSizeInSamples) {
-        // swap to the other buffer
-        std::swap(currentAudioBuffer, capturedAudioBuffer);
-        // reset buffer position
-        audioBufferPos = 0;
-        xTaskNotify(writerTaskHandle, 1, eIncrement);
-    }
-}
-
-void i2sReaderTask(void* param) {
-    Recorder* recorder = (Recorder*) param;
-
-    while (true) {
-        i2s_event_t evt;
-        if (xQueueReceive(recorder->i2sQueue, &evt, portMAX_DELAY) == pdPASS) {
-            if (evt.type == I2S_EVENT_RX_DONE) {
-                size_t bytesRead = 0;
-                do  {
-                    // read data from the I2S peripheral
-                    uint8_t i2sData[1024];
-                    i2s_read(recorder->getI2SPort(), i2sData, 1024, &bytesRead, 10);
-                    recorder->processI2SData(i2sData, bytesRead);
-                } while (bytesRead > 0);
-            }
-        }
-    }
-}
-
-void Recorder::start(i2s_port_t _i2sPort, i2s_config_t &_i2sConfig, int32_t _bufferSizeInBytes, TaskHandle_t _writerTaskHandle) {
-    i2sPort = _i2sPort;
+void Recorder::start(int32_t _bufferSizeInBytes, TaskHandle_t _writerTaskHandle) {
     writerTaskHandle = _writerTaskHandle;
     bufferSizeInSamples = _bufferSizeInBytes / sizeof(int16_t);
     bufferSizeInBytes = _bufferSizeInBytes;
@@ -43,26 +13,27 @@ void Recorder::start(i2s_port_t _i2sPort, i2s_config_t &_i2sConfig, int32_t _buf
 
     currentAudioBuffer = audioBuffer1;
     capturedAudioBuffer = audioBuffer2;
-
-    i2s_driver_install(i2sPort, &_i2sConfig, 4, &i2sQueue);
-    configureI2S();
-    TaskHandle_t readerTaskHandle;
-    xTaskCreatePinnedToCore(i2sReaderTask, "i2s Reader Task", 4096, this, 1, &readerTaskHandle, 0);
-}
-
-Recorder::Recorder(adc_unit_t _adcUnit, adc1_channel_t _adcChannel) {
-    adcUnit = _adcUnit;
-    adcChannel = _adcChannel;
 }
 
-void Recorder::configureI2S() {
-    i2s_set_adc_mode(adcUnit, adcChannel);
-    i2s_adc_enable(getI2SPort());
-}
-
-void Recorder::processI2SData(uint8_t* i2sData, size_t bytesRead) {
-    uint16_t* rawSamples = (uint16_t*) i2sData;
-    for (int i = 0; i < bytesRead / 2; i++) {
-        addSample((2048 - (rawSamples[i] & 0xfff)) * 15);
+void Recorder::WriteSamples(const int16_t* samples, size_t count) {
+    size_t samplesLeft = count;
+    while (samplesLeft > 0) {
+        // copy as much as fits into the current audio buffer
+        size_t blockSize = bufferSizeInSamples - audioBufferPos;
+        if (blockSize > samplesLeft) {
+            blockSize = samplesLeft;
+        }
+        memcpy(currentAudioBuffer + audioBufferPos, samples, blockSize * sizeof(int16_t));
+        samples += blockSize;
+        samplesLeft -= blockSize;
+        audioBufferPos += blockSize;
+
+        if (audioBufferPos == bufferSizeInSamples) {
+            // swap to the other buffer
+            std::swap(currentAudioBuffer, capturedAudioBuffer);
+            // reset buffer position
+            audioBufferPos = 0;
+            xTaskNotify(writerTaskHandle, 1, eIncrement);
+        }
     }
 }
@@ -11,36 +11,83 @@
 #include "esp_err.h"
 #include "esp_log.h"
 #include "freertos/FreeRTOS.h"
-#include "freertos/queue.h"
-#include "freertos/semphr.h"
 #include "freertos/task.h"
 
 #define RB_TAG "RINGBUF"
 
+/*
+ * The writer publishes head with a release store after copying data in, and the
+ * reader publishes tail with a release store after copying data out, so the
+ * matching acquire load on the other side always sees the bytes it covers.
+ */
+static inline uint32_t rb_load(volatile uint32_t* index) {
+  return __atomic_load_n(index, __ATOMIC_ACQUIRE);
+}
+
+static inline void rb_publish(volatile uint32_t* index, uint32_t value) {
+  __atomic_store_n(index, value, __ATOMIC_SEQ_CST);
+}
+
+static void rb_notify(TaskHandle_t volatile* waiting_task) {
+  TaskHandle_t task = __atomic_load_n(waiting_task, __ATOMIC_SEQ_CST);
+  if (task) {
+    xTaskNotifyGive(task);
+  }
+}
+
+/*
+ * Register the calling task as waiting and sleep until notified or until the
+ * deadline. The caller has to re-check its condition after registering, so a
+ * notification sent between its check and the registration is not lost:
+ * registering and publishing are both sequentially consistent, so at least one
+ * side sees the other.
+ */
+static void rb_register_waiter(TaskHandle_t volatile* waiting_task) {
+  __atomic_store_n(waiting_task, xTaskGetCurrentTaskHandle(), __ATOMIC_SEQ_CST);
+}
+
+static bool rb_sleep(TaskHandle_t volatile* waiting_task, TickType_t start,
+                     uint32_t ticks_to_wait) {
+  TickType_t remaining = portMAX_DELAY;
+  if (ticks_to_wait != portMAX_DELAY) {
+    TickType_t elapsed = xTaskGetTickCount() - start;
+    if (elapsed >= ticks_to_wait) {
+      __atomic_store_n(waiting_task, (TaskHandle_t) NULL, __ATOMIC_SEQ_CST);
+      return false;
+    }
+    remaining = ticks_to_wait - elapsed;
+  }
+  ulTaskNotifyTake(pdTRUE, remaining);
+  __atomic_store_n(waiting_task, (TaskHandle_t) NULL, __ATOMIC_SEQ_CST);
+  return true;
+}
+
 ringbuf_t* rb_init(const char* name, uint32_t size) {
   ringbuf_t* r;
   unsigned char* buf;
 
-  if (size < 2 || !name) {
+  if (size < 2 || size > 0x80000000u || !name) {
     return NULL;
   }
+  uint32_t rounded_size = 2;
+  while (rounded_size < size) {
+    rounded_size <<= 1;
+  }
 
   r = (ringbuf_t*) malloc(sizeof(ringbuf_t));
   assert(r);
-  buf = (unsigned char*) calloc(1, size);
+  buf = (unsigned char*) calloc(1, rounded_size);
   assert(buf);
 
   r->name = (char*)name;
-  r->base = r->readptr = r->writeptr = buf;
-  r->fill_cnt = 0;
-  r->size = size;
-
-  vSemaphoreCreateBinary(r->can_read);
-  assert(r->can_read);
-  vSemaphoreCreateBinary(r->can_write);
-  assert(r->can_write);
-  r->lock = xSemaphoreCreateMutex();
-  assert(r->lock);
+  r->base = buf;
+  r->size = rounded_size;
+  r->mask = rounded_size - 1;
+  r->head = 0;
+  r->tail = 0;
+  r->write_reserve = 0;
+  r->waiting_reader = NULL;
+  r->waiting_writer = NULL;
 
   r->abort_read = 0;
   r->abort_write = 0;
@@ -53,104 +100,78 @@ ringbuf_t* rb_init(const char* name, uint32_t size) {
 void rb_cleanup(ringbuf_t* rb) {
   free(rb->base);
   rb->base = NULL;
-  vSemaphoreDelete(rb->can_read);
-  rb->can_read = NULL;
-  vSemaphoreDelete(rb->can_write);
-  rb->can_write = NULL;
-  vSemaphoreDelete(rb->lock);
-  rb->lock = NULL;
   free(rb);
 }
 
 /*
  * @brief: get the number of filled bytes in the buffer
  */
-ssize_t rb_filled(ringbuf_t* rb) { return rb->fill_cnt; }
+ssize_t rb_filled(ringbuf_t* rb) { return rb_load(&rb->head) - rb_load(&rb->tail); }
 
 /*
  * @brief: get the number of empty bytes available in the buffer
  */
 ssize_t rb_available(ringbuf_t* rb) {
-  ESP_LOGD(RB_TAG, "rb leftover %d bytes", rb->size - rb->fill_cnt);
-  return (rb->size - rb->fill_cnt);
+  ssize_t available = rb->size - rb_filled(rb);
+  ESP_LOGD(RB_TAG, "rb leftover %d bytes", (int) available);
+  return available;
 }
 
 int rb_read(ringbuf_t* rb, uint8_t* buf, int buf_len, uint32_t ticks_to_wait) {
-  int read_size;
   int total_read_size = 0;
-
-  /**
-   * In case where we are able to read buf_len in one go,
-   * we are not able to check for abort and keep returning buf_len as bytes
-   * read. Check for argument validity check and abort case before entering
-   * memcpy loop.
-   */
+  TickType_t start = xTaskGetTickCount();
 
   if (rb == NULL || rb->abort_read == 1) {
     return ESP_FAIL;
   }
 
-  xSemaphoreTake(rb->lock, portMAX_DELAY);
-
   while (buf_len) {
-    if (rb->fill_cnt < buf_len) {
-      read_size = rb->fill_cnt;
-    } else {
-      read_size = buf_len;
-    }
-    if ((rb->readptr + read_size) > (rb->base + rb->size)) {
-      int rlen1 = rb->base + rb->size - rb->readptr;
-      int rlen2 = read_size - rlen1;
-      if (buf) {
-        memcpy(buf, rb->readptr, rlen1);
-        memcpy(buf + rlen1, rb->base, rlen2);
+    const uint32_t tail = rb->tail;
+    const uint32_t filled = rb_load(&rb->head) - tail;
+    if (filled == 0) {
+      if (rb->abort_read == 1) {
+        total_read_size = RB_ABORT;
+        break;
+      }
+      if (rb->writer_finished == 1) {
+        break;
+      }
+      if (rb->reader_unblock == 1) {
+        if (total_read_size == 0) {
+          total_read_size = RB_READER_UNBLOCK;
+        }
+        break;
       }
-      rb->readptr = rb->base + rlen2;
-    } else {
-      if (buf) {
-        memcpy(buf, rb->readptr, read_size);
+      if (ticks_to_wait == 0) {
+        break;
       }
-      rb->readptr = rb->readptr + read_size;
+      rb_register_waiter(&rb->waiting_reader);
+      if (__atomic_load_n(&rb->head, __ATOMIC_SEQ_CST) != tail || rb->abort_read || rb->writer_finished ||
+          rb->reader_unblock) {
+        rb->waiting_reader = NULL;
+        continue;
+      }
+      if (!rb_sleep(&rb->waiting_reader, start, ticks_to_wait)) {
+        break;
+      }
+      continue;
     }
 
-    buf_len -= read_size;
-    rb->fill_cnt -= read_size;
-    total_read_size += read_size;
+    const uint32_t read_size = filled < (uint32_t) buf_len ? filled : buf_len;
+    const uint32_t offset = tail & rb->mask;
+    const uint32_t rlen1 = (offset + read_size > rb->size) ? rb->size - offset : read_size;
     if (buf) {
+      memcpy(buf, rb->base + offset, rlen1);
+      memcpy(buf + rlen1, rb->base, read_size - rlen1);
       buf += read_size;
     }
+    rb_publish(&rb->tail, tail + read_size);
+    rb_notify(&rb->waiting_writer);
 
-    xSemaphoreGive(rb->can_write);
-
-    if (buf_len == 0) {
-      break;
-    }
-
-    xSemaphoreGive(rb->lock);
-    if (!rb->writer_finished && !rb->abort_read && !rb->reader_unblock) {
-      if (xSemaphoreTake(rb->can_read, ticks_to_wait) != pdTRUE) {
-        goto out;
-      }
-    }
-    if (rb->abort_read == 1) {
-      total_read_size = RB_ABORT;
-      goto out;
-    }
-    if (rb->writer_finished == 1) {
-      goto out;
-    }
-    if (rb->reader_unblock == 1) {
-      if (total_read_size == 0) {
-        total_read_size = RB_READER_UNBLOCK;
-      }
-      goto out;
-    }
-
-    xSemaphoreTake(rb->lock, portMAX_DELAY);
+    buf_len -= read_size;
+    total_read_size += read_size;
   }
 
-  xSemaphoreGive(rb->lock);
-out:
   if (rb->writer_finished == 1 && total_read_size == 0) {
     total_read_size = RB_WRITER_FINISHED;
   }
@@ -160,66 +181,184 @@ out:
 
 int rb_write(ringbuf_t* rb, const uint8_t* buf, int buf_len,
              uint32_t ticks_to_wait) {
-  int write_size;
   int total_write_size = 0;
-
-  /**
-   * In case where we are able to write buf_len in one go,
-   * we are not able to check for abort and keep returning buf_len as bytes
-   * written. Check for arguments' validity and abort case before entering
-   * memcpy loop.
-   */
+  TickType_t start = xTaskGetTickCount();
 
   if (rb == NULL || buf == NULL || rb->abort_write == 1) {
     return RB_FAIL;
   }
 
-  xSemaphoreTake(rb->lock, portMAX_DELAY);
-
   while (buf_len) {
-    if ((rb->size - rb->fill_cnt) < buf_len) {
-      write_size = rb->size - rb->fill_cnt;
-    } else {
-      write_size = buf_len;
-    }
-    if ((rb->writeptr + write_size) > (rb->base + rb->size)) {
-      int wlen1 = rb->base + rb->size - rb->writeptr;
-      int wlen2 = write_size - wlen1;
-      memcpy(rb->writeptr, buf, wlen1);
-      memcpy(rb->base, buf + wlen1, wlen2);
-      rb->writeptr = rb->base + wlen2;
-    } else {
-      memcpy(rb->writeptr, buf, write_size);
-      rb->writeptr = rb->writeptr + write_size;
+    const uint32_t head = rb->head;
+    const uint32_t available = rb->size - (head - rb_load(&rb->tail));
+    if (available == 0) {
+      if (rb->abort_write == 1 || ticks_to_wait == 0) {
+        break;
+      }
+      if (rb->writer_finished) {
+        return total_write_size > 0 ? total_write_size : RB_WRITER_FINISHED;
+      }
+      rb_register_waiter(&rb->waiting_writer);
+      if (__atomic_load_n(&rb->tail, __ATOMIC_SEQ_CST) + rb->size != head || rb->abort_write) {
+        rb->waiting_writer = NULL;
+        continue;
+      }
+      if (!rb_sleep(&rb->waiting_writer, start, ticks_to_wait)) {
+        break;
+      }
+      continue;
     }
 
+    const uint32_t write_size = available < (uint32_t) buf_len ? available : buf_len;
+    const uint32_t offset = head & rb->mask;
+    const uint32_t wlen1 = (offset + write_size > rb->size) ? rb->size - offset : write_size;
+    memcpy(rb->base + offset, buf, wlen1);
+    memcpy(rb->base, buf + wlen1, write_size - wlen1);
+    rb_publish(&rb->head, head + write_size);
+    rb_notify(&rb->waiting_reader);
+
     buf_len -= write_size;
-    rb->fill_cnt += write_size;
     total_write_size += write_size;
     buf += write_size;
+  }
+
+  return total_write_size;
+}
+
+int rb_peek(ringbuf_t* rb, uint8_t** ptr1, int* len1, uint8_t** ptr2, int* len2,
+            int len, uint32_t ticks_to_wait) {
+  TickType_t start = xTaskGetTickCount();
 
-    xSemaphoreGive(rb->can_read);
+  *len1 = 0;
+  *len2 = 0;
+  if (rb == NULL || rb->abort_read == 1) {
+    return ESP_FAIL;
+  }
 
-    if (buf_len == 0) {
+  const uint32_t tail = rb->tail;
+  uint32_t filled = rb_load(&rb->head) - tail;
+  while (filled < (uint32_t) len && ticks_to_wait != 0) {
+    if (rb->abort_read == 1) {
+      return RB_ABORT;
+    }
+    if (rb->writer_finished == 1 || rb->reader_unblock == 1) {
+      break;
+    }
+    rb_register_waiter(&rb->waiting_reader);
+    if (__atomic_load_n(&rb->head, __ATOMIC_SEQ_CST) - tail != filled || rb->abort_read ||
+        rb->writer_finished || rb->reader_unblock) {
+      rb->waiting_reader = NULL;
+    } else if (!rb_sleep(&rb->waiting_reader, start, ticks_to_wait)) {
       break;
     }
+    filled = rb_load(&rb->head) - tail;
+  }
+  rb->reader_unblock = 0;
+
+  const uint32_t peek_size = filled < (uint32_t) len ? filled : len;
+  if (peek_size == 0 && rb->writer_finished == 1) {
+    return RB_WRITER_FINISHED;
+  }
+  const uint32_t offset = tail & rb->mask;
+  const uint32_t plen1 = (offset + peek_size > rb->size) ? rb->size - offset : peek_size;
+  *ptr1 = rb->base + offset;
+  *len1 = plen1;
+  *ptr2 = rb->base;
+  *len2 = peek_size - plen1;
+  return peek_size;
+}
+
+int rb_commit_read(ringbuf_t* rb, int len) {
+  // Committing more than is filled would move tail past head, and the ring would
+  // then read as almost full of stale data.
+  if (rb == NULL || len < 0 || (uint32_t) len > rb_load(&rb->head) - rb->tail) {
+    return RB_FAIL;
+  }
+  rb_publish(&rb->tail, rb->tail + len);
+  rb_notify(&rb->waiting_writer);
+  return len;
+}
+
+int rb_write_overwrite(ringbuf_t* rb, const uint8_t* buf, int len) {
+  if (rb == NULL || buf == NULL || rb->abort_write == 1) {
+    return RB_FAIL;
+  }
+
+  const int written = len;
+  uint32_t head = rb->head;
+  // Only the last size bytes of an oversized write would survive anyway, but the
+  // position still moves on by all of it.
+  if ((uint32_t) len > rb->size) {
+    head += len - rb->size;
+    buf += len - rb->size;
+    len = rb->size;
+  }
+
+  /*
+   * Announce the range about to be overwritten before touching it, so a reader
+   * checking rb_is_intact afterwards sees it even if it raced with the copy.
+   */
+  rb_publish(&rb->write_reserve, head + len);
+  __atomic_thread_fence(__ATOMIC_SEQ_CST);
+
+  const uint32_t offset = head & rb->mask;
+  const uint32_t wlen1 = (offset + len > rb->size) ? rb->size - offset : len;
+  memcpy(rb->base + offset, buf, wlen1);
+  memcpy(rb->base, buf + wlen1, len - wlen1);
+  rb_publish(&rb->head, head + len);
+  rb_notify(&rb->waiting_reader);
+  return written;
+}
+
+uint32_t rb_write_position(ringbuf_t* rb) { return rb_load(&rb->head); }
+
+int rb_is_intact(ringbuf_t* rb, uint32_t position) {
+  __atomic_thread_fence(__ATOMIC_SEQ_CST);
+  const uint32_t reserve = __atomic_load_n(&rb->write_reserve, __ATOMIC_SEQ_CST);
+  // Positions are free running, compare their distance so wrapping doesn't matter.
+  return (int32_t) (reserve - rb->size - position) <= 0;
+}
+
+int rb_peek_at(ringbuf_t* rb, uint32_t position, uint8_t** ptr1, int* len1,
+               uint8_t** ptr2, int* len2, int len, uint32_t ticks_to_wait) {
+  TickType_t start = xTaskGetTickCount();
+
+  *len1 = 0;
+  *len2 = 0;
+  if (rb == NULL || rb->abort_read == 1) {
+    return ESP_FAIL;
+  }
 
-    xSemaphoreGive(rb->lock);
-    if (rb->writer_finished) {
-      return write_size > 0 ? write_size : RB_WRITER_FINISHED;
+  uint32_t head = rb_load(&rb->head);
+  while ((int32_t) (position + len - head) > 0 && ticks_to_wait != 0) {
+    if (rb->abort_read == 1) {
+      return RB_ABORT;
     }
-    if (xSemaphoreTake(rb->can_write, ticks_to_wait) != pdTRUE) {
-      goto out;
+    if (rb->writer_finished == 1) {
+      break;
     }
-    if (rb->abort_write == 1) {
-      goto out;
+    rb_register_waiter(&rb->waiting_reader);
+    if (__atomic_load_n(&rb->head, __ATOMIC_SEQ_CST) != head || rb->abort_read ||
+        rb->writer_finished) {
+      rb->waiting_reader = NULL;
+    } else if (!rb_sleep(&rb->waiting_reader, start, ticks_to_wait)) {
+      break;
     }
-    xSemaphoreTake(rb->lock, portMAX_DELAY);
+    head = rb_load(&rb->head);
   }
 
-  xSemaphoreGive(rb->lock);
-out:
-  return total_write_size;
+  if (!rb_is_intact(rb, position)) {
+    return RB_OVERWRITTEN;
+  }
+  const int32_t written = head - position;
+  const uint32_t peek_size = written <= 0 ? 0 : (written < len ? written : len);
+  const uint32_t offset = position & rb->mask;
+  const uint32_t plen1 = (offset + peek_size > rb->size) ? rb->size - offset : peek_size;
+  *ptr1 = rb->base + offset;
+  *len1 = plen1;
+  *ptr2 = rb->base;
+  *len2 = peek_size - plen1;
+  return peek_size;
 }
 
 /**
@@ -229,14 +368,11 @@ static void _rb_reset(ringbuf_t* rb, int abort_read, int abort_write) {
   if (rb == NULL) {
     return;
   }
-  xSemaphoreTake(rb->lock, portMAX_DELAY);
-  rb->readptr = rb->writeptr = rb->base;
-  rb->fill_cnt = 0;
+  rb->head = rb->tail = rb->write_reserve = 0;
   rb->writer_finished = 0;
   rb->reader_unblock = 0;
   rb->abort_read = abort_read;
   rb->abort_write = abort_write;
-  xSemaphoreGive(rb->lock);
 }
 
 void rb_reset(ringbuf_t* rb) { _rb_reset(rb, 0, 0); }
@@ -246,8 +382,7 @@ void rb_abort_read(ringbuf_t* rb) {
     return;
   }
   rb->abort_read = 1;
-  xSemaphoreGive(rb->can_read);
-  xSemaphoreGive(rb->lock);
+  rb_notify(&rb->waiting_reader);
 }
 
 void rb_abort_write(ringbuf_t* rb) {
@@ -255,8 +390,7 @@ void rb_abort_write(ringbuf_t* rb) {
     return;
   }
   rb->abort_write = 1;
-  xSemaphoreGive(rb->can_write);
-  xSemaphoreGive(rb->lock);
+  rb_notify(&rb->waiting_writer);
 }
 
 void rb_abort(ringbuf_t* rb) {
@@ -265,20 +399,16 @@ void rb_abort(ringbuf_t* rb) {
   }
   rb->abort_read = 1;
   rb->abort_write = 1;
-  xSemaphoreGive(rb->can_read);
-  xSemaphoreGive(rb->can_write);
-  xSemaphoreGive(rb->lock);
+  rb_notify(&rb->waiting_reader);
+  rb_notify(&rb->waiting_writer);
 }
 
 /**
  * Reset the ringbuffer and keep rb_write aborted.
- * Note that we are taking lock before even toggling `abort_write` variable.
- * This serves a special purpose to not allow this abort to be mixed with
- * rb_write.
  */
 void rb_reset_and_abort_write(ringbuf_t* rb) {
   _rb_reset(rb, 0, 1);
-  xSemaphoreGive(rb->can_write);
+  rb_notify(&rb->waiting_writer);
 }
 
 void rb_signal_writer_finished(ringbuf_t* rb) {
@@ -286,7 +416,7 @@ void rb_signal_writer_finished(ringbuf_t* rb) {
     return;
   }
   rb->writer_finished = 1;
-  xSemaphoreGive(rb->can_read);
+  rb_notify(&rb->waiting_reader);
 }
 
 int rb_is_writer_finished(ringbuf_t* rb) {
@@ -301,13 +431,12 @@ void rb_wakeup_reader(ringbuf_t* rb) {
     return;
   }
   rb->reader_unblock = 1;
-  xSemaphoreGive(rb->can_read);
+  rb_notify(&rb->waiting_reader);
 }
 
 void rb_stat(ringbuf_t* rb) {
-  xSemaphoreTake(rb->lock, portMAX_DELAY);
   ESP_LOGI(RB_TAG,
-           "filled: %d, base: %p, read_ptr: %p, write_ptr: %p, size: %d\n",
-           rb->fill_cnt, rb->base, rb->readptr, rb->writeptr, rb->size);
-  xSemaphoreGive(rb->lock);
+           "filled: %d, base: %p, head: %u, tail: %u, size: %u\n",
+           (int) rb_filled(rb), rb->base, (unsigned) rb->head, (unsigned) rb->tail,
+           (unsigned) rb->size);
 }
@@ -0,0 +1,124 @@
+#include "StreamingState.h"
+
+#include <cstring>
+
+namespace {
+    bool Overlaps(const TfLiteTensor* a, const TfLiteTensor* b) {
+        return (a->data.int8 < b->data.int8 + b->bytes) && (b->data.int8 < a->data.int8 + a->bytes);
+    }
+}
+
+StreamingState::StreamingState()
+    : _state_count(0),
+      _staging(nullptr),
+      _staging_size(0) {
+}
+
+StreamingState::~StreamingState() {
+    delete[] _staging;
+}
+
+TfLiteStatus StreamingState::Initialize(tflite::ErrorReporter* error_reporter,
+                                        tflite::MicroInterpreter* interpreter,
+                                        int feature_input, int score_output) {
+    if ((interpreter->inputs_size() > kMaxStates + 1) || (interpreter->outputs_size() > kMaxStates + 1)) {
+        TF_LITE_REPORT_ERROR(error_reporter, "The model has more than %d state tensors", kMaxStates);
+        return kTfLiteError;
+    }
+    TfLiteTensor* inputs[kMaxStates + 1];
+    const TfLiteTensor* outputs[kMaxStates + 1];
+    for (size_t i = 0; i < interpreter->inputs_size(); ++i) {
+        inputs[i] = interpreter->input(i);
+    }
+    for (size_t i = 0; i < interpreter->outputs_size(); ++i) {
+        outputs[i] = interpreter->output(i);
+    }
+    return Initialize(error_reporter, inputs, interpreter->inputs_size(), outputs,
+                      interpreter->outputs_size(), feature_input, score_output);
+}
+
+TfLiteStatus StreamingState::Initialize(tflite::ErrorReporter* error_reporter,
+                                        TfLiteTensor* const* inputs, int input_count,
+                                        const TfLiteTensor* const* outputs, int output_count,
+                                        int feature_input, int score_output) {
+    _state_count = 0;
+    if ((input_count > kMaxStates + 1) || (output_count > kMaxStates + 1)) {
+        TF_LITE_REPORT_ERROR(error_reporter, "The model has more than %d state tensors", kMaxStates);
+        return kTfLiteError;
+    }
+    bool output_used[kMaxStates + 1] = {false};
+    size_t state_bytes = 0;
+    for (int i = 0; i < input_count; ++i) {
+        if (i == feature_input) {
+            continue;
+        }
+        TfLiteTensor* input = inputs[i];
+        const TfLiteTensor* output = nullptr;
+        for (int j = 0; j < output_count; ++j) {
+            const TfLiteTensor* candidate = outputs[j];
+            if ((j != score_output) && !output_used[j] &&
+                (candidate->type == input->type) && (candidate->bytes == input->bytes) &&
+                (candidate->params.scale == input->params.scale) &&
+                (candidate->params.zero_point == input->params.zero_point)) {
+                output = candidate;
+                output_used[j] = true;
+                break;
+            }
+        }
+        if (!output) {
+            TF_LITE_REPORT_ERROR(error_reporter, "No output for state input %d", i);
+            return kTfLiteError;
+        }
+        _state_inputs[_state_count] = input;
+        _state_outputs[_state_count] = output;
+        ++_state_count;
+        state_bytes += input->bytes;
+    }
+
+    bool needs_staging = false;
+    for (int i = 0; i < _state_count; ++i) {
+        for (int j = 0; j < _state_count; ++j) {
+            if ((i != j) && Overlaps(_state_outputs[i], _state_inputs[j])) {
+                needs_staging = true;
+            }
+        }
+    }
+    if (needs_staging && (_staging_size < state_bytes)) {
+        delete[] _staging;
+        _staging = new int8_t[state_bytes];
+        _staging_size = state_bytes;
+    } else if (!needs_staging) {
+        delete[] _staging;
+        _staging = nullptr;
+        _staging_size = 0;
+    }
+
+    Reset();
+    return kTfLiteOk;
+}
+
+void StreamingState::Reset() {
+    // Zero in the quantized domain, which is what the state is before any audio.
+    for (int i = 0; i < _state_count; ++i) {
+        memset(_state_inputs[i]->data.int8, _state_inputs[i]->params.zero_point, _state_inputs[i]->bytes);
+    }
+}
+
+void StreamingState::Carry() {
+    if (!_staging) {
+        for (int i = 0; i < _state_count; ++i) {
+            memmove(_state_inputs[i]->data.int8, _state_outputs[i]->data.int8, _state_inputs[i]->bytes);
+        }
+        return;
+    }
+    int8_t* staged = _staging;
+    for (int i = 0; i < _state_count; ++i) {
+        memcpy(staged, _state_outputs[i]->data.int8, _state_outputs[i]->bytes);
+        staged += _state_outputs[i]->bytes;
+    }
+    staged = _staging;
+    for (int i = 0; i < _state_count; ++i) {
+        memcpy(_state_inputs[i]->data.int8, staged, _state_inputs[i]->bytes);
+        staged += _state_inputs[i]->bytes;
+    }
+}
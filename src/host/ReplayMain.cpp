@@ -0,0 +1,179 @@
+// Entry point for [env:native]: replays recorded pump audio through the same
+// setup_app()/loop_app() pipeline the firmware runs, without any hardware.
+//
+// Usage: program [--model model.tflite] [--scores scores.txt] <clip.raw|clip.wav>...
+// Clips are concatenated in the order given and must be 16kHz mono signed
+// 16-bit PCM, which is what split_and_convert.sh produces. A model given with
+// --model is put in the first model slot, so it is used instead of the built-in one.
+// --scores writes the time and raw output of every inference, one per line, so the
+// output of builds with different kernels can be compared byte for byte.
+
+// The unit tests are built with the rest of the sources and bring their own main().
+#ifndef PIO_UNIT_TESTING
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+#include "App.h"
+#include "MicroModelSettings.h"
+#include "ModelLoader.h"
+#include "driver/i2s.h"
+#include "esp_partition.h"
+
+namespace {
+    // Released 100ms at a time, the capture engine reads it a DMA buffer at a time.
+    constexpr size_t kReplayChunkSamples = kAudioSampleFrequency / 10;
+
+    uint32_t ReadLE32(const uint8_t* data) {
+        return data[0] | (data[1] << 8) | (data[2] << 16) | ((uint32_t) data[3] << 24);
+    }
+
+    uint16_t ReadLE16(const uint8_t* data) {
+        return data[0] | (data[1] << 8);
+    }
+
+    bool EndsWith(const char* text, const char* suffix) {
+        const size_t text_length = strlen(text);
+        const size_t suffix_length = strlen(suffix);
+        return (text_length >= suffix_length) &&
+            (strcmp(text + text_length - suffix_length, suffix) == 0);
+    }
+
+    // Finds the PCM payload of a WAV file, checking it matches the model's audio format.
+    bool FindWavData(const char* path, const std::vector<uint8_t>& file,
+                     size_t* data_offset, size_t* data_size) {
+        if ((file.size() < 12) || (memcmp(file.data(), "RIFF", 4) != 0) ||
+            (memcmp(file.data() + 8, "WAVE", 4) != 0)) {
+            fprintf(stderr, "%s: not a WAV file\n", path);
+            return false;
+        }
+        bool format_ok = false;
+        size_t offset = 12;
+        while (offset + 8 <= file.size()) {
+            const uint8_t* chunk = file.data() + offset;
+            const size_t chunk_size = ReadLE32(chunk + 4);
+            if ((memcmp(chunk, "fmt ", 4) == 0) && (chunk_size >= 16)) {
+                format_ok = (ReadLE16(chunk + 8) == 1) && (ReadLE16(chunk + 10) == 1) &&
+                    (ReadLE32(chunk + 12) == kAudioSampleFrequency) && (ReadLE16(chunk + 22) == 16);
+            } else if (memcmp(chunk, "data", 4) == 0) {
+                if (!format_ok) {
+                    fprintf(stderr, "%s: expected %dHz mono 16-bit PCM\n", path, kAudioSampleFrequency);
+                    return false;
+                }
+                *data_offset = offset + 8;
+                *data_size = std::min(chunk_size, file.size() - *data_offset);
+                return true;
+            }
+            offset += 8 + chunk_size + (chunk_size & 1);
+        }
+        fprintf(stderr, "%s: no data chunk\n", path);
+        return false;
+    }
+
+    bool ReadFile(const char* path, std::vector<uint8_t>* contents) {
+        FILE* file = fopen(path, "rb");
+        if (!file) {
+            fprintf(stderr, "%s: could not open\n", path);
+            return false;
+        }
+        uint8_t block[4096];
+        size_t bytes_read;
+        while ((bytes_read = fread(block, 1, sizeof(block), file)) > 0) {
+            contents->insert(contents->end(), block, block + bytes_read);
+        }
+        fclose(file);
+        return true;
+    }
+
+    bool LoadSamples(const char* path, std::vector<int16_t>* samples) {
+        std::vector<uint8_t> contents;
+        if (!ReadFile(path, &contents)) {
+            return false;
+        }
+
+        size_t data_offset = 0;
+        size_t data_size = contents.size();
+        if (EndsWith(path, ".wav") && !FindWavData(path, contents, &data_offset, &data_size)) {
+            return false;
+        }
+        const size_t sample_count = data_size / sizeof(int16_t);
+        const size_t first_sample = samples->size();
+        samples->resize(first_sample + sample_count);
+        memcpy(samples->data() + first_sample, contents.data() + data_offset,
+               sample_count * sizeof(int16_t));
+        return true;
+    }
+
+    FILE* scores_file = nullptr;
+
+    void WriteScores(int64_t time_in_ms, const int8_t* scores, int score_count) {
+        fprintf(scores_file, "%lld", (long long) time_in_ms);
+        for (int i = 0; i < score_count; ++i) {
+            fprintf(scores_file, " %d", scores[i]);
+        }
+        fputc('\n', scores_file);
+    }
+}
+
+int main(int argc, char** argv) {
+    int first_clip = 1;
+    std::vector<uint8_t> model;
+    const char* scores_path = nullptr;
+    while ((first_clip + 1 < argc) && (strncmp(argv[first_clip], "--", 2) == 0)) {
+        if (strcmp(argv[first_clip], "--model") == 0) {
+            if (!ReadFile(argv[first_clip + 1], &model)) {
+                return 1;
+            }
+            esp_partition_host_add(kModelPartitionSubtype, kModelPartitionLabels[0], model.data(), model.size());
+        } else if (strcmp(argv[first_clip], "--scores") == 0) {
+            scores_path = argv[first_clip + 1];
+        } else {
+            break;
+        }
+        first_clip += 2;
+    }
+    if (first_clip >= argc) {
+        fprintf(stderr, "Usage: %s [--model model.tflite] [--scores scores.txt] <clip.raw|clip.wav>...\n",
+                argv[0]);
+        return 1;
+    }
+
+    std::vector<int16_t> samples;
+    for (int i = first_clip; i < argc; ++i) {
+        if (!LoadSamples(argv[i], &samples)) {
+            return 1;
+        }
+    }
+    i2s_host_set_source(samples.data(), samples.size(), kReplayChunkSamples);
+
+    if (scores_path) {
+        scores_file = fopen(scores_path, "w");
+        if (!scores_file) {
+            fprintf(stderr, "%s: could not open\n", scores_path);
+            return 1;
+        }
+        set_app_score_callback(WriteScores);
+    }
+
+    const auto start = std::chrono::steady_clock::now();
+    setup_app();
+    // The first loop_app() installs the I2S driver, which releases the first chunk.
+    loop_app();
+    while (i2s_host_advance()) {
+        loop_app();
+    }
+    const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+    report_app();
+    if (scores_file) {
+        fclose(scores_file);
+    }
+    const double audio_seconds = (double) samples.size() / kAudioSampleFrequency;
+    fprintf(stderr, "Replayed %.1fs of audio in %.3fs (%.1fx real time)\n",
+            audio_seconds, elapsed.count(), audio_seconds / elapsed.count());
+    return 0;
+}
+#endif // PIO_UNIT_TESTING
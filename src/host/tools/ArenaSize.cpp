@@ -0,0 +1,179 @@
+// Entry point for [env:arena_size]: works out how much tensor arena the model needs
+// by allocating it in a large arena with a RecordingMicroAllocator.
+//
+// Usage: program [--write include/TensorArenaSize.h] [model.tflite]
+// Measures the model in src/model.cpp unless a .tflite file is given, and prints the
+// arena usage broken down by allocation type and by tensor. With --write it also
+// writes the header the firmware takes kTensorArenaSize from.
+//
+// Pointers are 8 bytes on a 64-bit host and 4 on the ESP32, so the persistent part
+// (tensor structs and op data) comes out larger than on the device. The result is
+// a safe upper bound; build with -m32 to match the device exactly.
+
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+#include "model.h"
+#include "ModelOps.h"
+#include "tensorflow/lite/micro/micro_error_reporter.h"
+#include "tensorflow/lite/micro/recording_micro_interpreter.h"
+#include "tensorflow/lite/schema/schema_generated.h"
+
+namespace {
+    // Big enough for any model that could fit in the ESP32's RAM.
+    constexpr size_t kMeasuringArenaSize = 256 * 1024;
+    // Kept on top of the measured size, the arena start may need aligning and
+    // TFLM's own bookkeeping varies a little between versions.
+    constexpr size_t kArenaHeadroomBytes = 256;
+    constexpr size_t kArenaRounding = 16;
+
+    struct AllocationTypeName {
+        tflite::RecordedAllocationType type;
+        const char* name;
+    };
+
+    const AllocationTypeName kAllocationTypes[] = {
+        {tflite::RecordedAllocationType::kTfLiteEvalTensorData, "eval tensors"},
+        {tflite::RecordedAllocationType::kPersistentTfLiteTensorData, "persistent tensors"},
+        {tflite::RecordedAllocationType::kPersistentTfLiteTensorQuantizationData, "tensor quantization"},
+        {tflite::RecordedAllocationType::kPersistentBufferData, "persistent buffers"},
+        {tflite::RecordedAllocationType::kTfLiteTensorVariableBufferData, "variable tensors"},
+        {tflite::RecordedAllocationType::kNodeAndRegistrationArray, "nodes and registrations"},
+        {tflite::RecordedAllocationType::kOpData, "op data"},
+    };
+
+    const char* AllocationTypeText(TfLiteAllocationType type) {
+        switch (type) {
+            case kTfLiteMmapRo:
+                return "flash";
+            case kTfLiteArenaRw:
+                return "arena";
+            case kTfLiteArenaRwPersistent:
+                return "persistent";
+            default:
+                return "other";
+        }
+    }
+
+    bool ReadFile(const char* path, std::vector<uint8_t>* contents) {
+        FILE* file = fopen(path, "rb");
+        if (!file) {
+            fprintf(stderr, "%s: could not open\n", path);
+            return false;
+        }
+        uint8_t block[4096];
+        size_t bytes_read;
+        while ((bytes_read = fread(block, 1, sizeof(block), file)) > 0) {
+            contents->insert(contents->end(), block, block + bytes_read);
+        }
+        fclose(file);
+        return true;
+    }
+
+    bool WriteHeader(const char* path, size_t arena_size, size_t model_len) {
+        FILE* file = fopen(path, "w");
+        if (!file) {
+            fprintf(stderr, "%s: could not open\n", path);
+            return false;
+        }
+        fprintf(file,
+                "#ifndef __TENSORARENASIZE_H_\n"
+                "#define __TENSORARENASIZE_H_\n"
+                "\n"
+                "// Written by the arena_size tool (src/host/tools/ArenaSize.cpp) for the model in\n"
+                "// src/model.cpp. Rerun it after retraining, see README.\n"
+                "\n"
+                "// Bytes of tensor arena the model needs, rounded up with some headroom.\n"
+                "constexpr int kTensorArenaSize = %u;\n"
+                "// g_model_len of the model it was measured for, setup_app() warns if that changes.\n"
+                "constexpr int kTensorArenaModelLen = %u;\n"
+                "\n"
+                "#endif // __TENSORARENASIZE_H_\n",
+                (unsigned) arena_size, (unsigned) model_len);
+        fclose(file);
+        return true;
+    }
+}
+
+int main(int argc, char** argv) {
+    const char* header_path = nullptr;
+    const char* model_path = nullptr;
+    for (int i = 1; i < argc; ++i) {
+        if ((strcmp(argv[i], "--write") == 0) && (i + 1 < argc)) {
+            header_path = argv[++i];
+        } else {
+            model_path = argv[i];
+        }
+    }
+
+    const uint8_t* model_data = g_model;
+    size_t model_len = g_model_len;
+    std::vector<uint8_t> model_file;
+    if (model_path) {
+        if (!ReadFile(model_path, &model_file)) {
+            return 1;
+        }
+        model_data = model_file.data();
+        model_len = model_file.size();
+    }
+
+    static tflite::MicroErrorReporter micro_error_reporter;
+    tflite::ErrorReporter* error_reporter = &micro_error_reporter;
+    const tflite::Model* model = tflite::GetModel(model_data);
+    if (model->version() != TFLITE_SCHEMA_VERSION) {
+        fprintf(stderr, "Model is schema version %d, not %d\n", (int) model->version(), TFLITE_SCHEMA_VERSION);
+        return 1;
+    }
+
+    static ModelOpResolver op_resolver(error_reporter);
+    if (AddModelOps(&op_resolver) != kTfLiteOk) {
+        return 1;
+    }
+
+    std::vector<uint8_t> arena(kMeasuringArenaSize);
+    tflite::RecordingMicroInterpreter interpreter(model, op_resolver, arena.data(), arena.size(),
+                                                  error_reporter);
+    if (interpreter.AllocateTensors() != kTfLiteOk) {
+        fprintf(stderr, "AllocateTensors() failed even with %u bytes\n", (unsigned) kMeasuringArenaSize);
+        return 1;
+    }
+
+    const tflite::RecordingMicroAllocator& allocator = interpreter.GetMicroAllocator();
+    allocator.PrintAllocations();
+
+    printf("\nBy type:\n");
+    for (const AllocationTypeName& allocation_type : kAllocationTypes) {
+        const tflite::RecordedAllocation allocation = allocator.GetRecordedAllocation(allocation_type.type);
+        printf("  %-24s %6u bytes (%u requested) in %u allocations\n", allocation_type.name,
+               (unsigned) allocation.used_bytes, (unsigned) allocation.requested_bytes,
+               (unsigned) allocation.count);
+    }
+
+    printf("\nBy tensor:\n");
+    size_t planned_bytes = 0;
+    for (size_t i = 0; i < interpreter.tensors_size(); ++i) {
+        const TfLiteTensor* tensor = interpreter.tensor(i);
+        printf("  %3u %-10s %6u bytes\n", (unsigned) i, AllocationTypeText(tensor->allocation_type),
+               (unsigned) tensor->bytes);
+        if (tensor->allocation_type == kTfLiteArenaRw) {
+            planned_bytes += tensor->bytes;
+        }
+    }
+    printf("  Arena tensors add up to %u bytes, the memory planner overlaps them where it can\n",
+           (unsigned) planned_bytes);
+
+    const size_t used_bytes = interpreter.arena_used_bytes();
+    const size_t arena_size =
+        ((used_bytes + kArenaHeadroomBytes + kArenaRounding - 1) / kArenaRounding) * kArenaRounding;
+    printf("\nArena used: %u bytes, kTensorArenaSize should be %u\n", (unsigned) used_bytes,
+           (unsigned) arena_size);
+
+    if (header_path) {
+        if (!WriteHeader(header_path, arena_size, model_len)) {
+            return 1;
+        }
+        printf("Wrote %s\n", header_path);
+    }
+    return 0;
+}
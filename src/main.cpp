@@ -6,8 +6,8 @@
 void setup() {
   setup_wifi();
   setup_app();
+  start_app_tasks();
 }
 void loop() {
   loop_wifi();
-  loop_app();
 }
@@ -1,4 +1,8 @@
-unsigned char g_model[] = {
+#include "model.h"
+
+// const so it stays in flash rather than being copied to DRAM at boot, and aligned
+// as flatbuffers expect.
+alignas(16) const unsigned char g_model[] = {
   0x1c, 0x00, 0x00, 0x00, 0x54, 0x46, 0x4c, 0x33, 0x00, 0x00, 0x12, 0x00,
   0x1c, 0x00, 0x04, 0x00, 0x08, 0x00, 0x0c, 0x00, 0x10, 0x00, 0x14, 0x00,
   0x00, 0x00, 0x18, 0x00, 0x12, 0x00, 0x00, 0x00, 0x03, 0x00, 0x00, 0x00,
@@ -1893,4 +1897,4 @@ unsigned char g_model[] = {
   0x0c, 0x00, 0x07, 0x00, 0x00, 0x00, 0x08, 0x00, 0x0a, 0x00, 0x00, 0x00,
   0x00, 0x00, 0x00, 0x04, 0x03, 0x00, 0x00, 0x00
 };
-unsigned int g_model_len = 22712;
+const int g_model_len = 22712;
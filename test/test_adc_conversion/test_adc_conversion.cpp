@@ -0,0 +1,111 @@
+// Checks ConvertAdcSamples against a plain per-sample reference, run on the host
+// with pio test -e native. On x86 hosts that exercises the SSE2 path, with block
+// lengths that leave every possible tail for the scalar loop.
+#include <unity.h>
+
+#include <stdint.h>
+#include <string.h>
+#include <vector>
+
+#include "AdcConversion.h"
+
+static uint32_t random_state = 1;
+
+static uint32_t NextRandom() {
+    random_state = (random_state * 1103515245u) + 12345u;
+    return random_state >> 8;
+}
+
+// The conversion as documented in AdcConversion.h, one sample at a time.
+static void ConvertReference(AdcConversion* conversion, const uint16_t* raw, int16_t* pcm,
+                             size_t count) {
+    if (count == 0) {
+        return;
+    }
+    const int32_t offset = conversion->remove_dc_offset ? (conversion->dc_offset_q8 + 128) >> 8 : 2048;
+    uint64_t sum = 0;
+    for (size_t i = 0; i < count; ++i) {
+        const int32_t sample = raw[i] & 0xfff;
+        sum += sample;
+        int32_t value = (offset - sample) * conversion->gain;
+        if (value > INT16_MAX) {
+            value = INT16_MAX;
+        } else if (value < INT16_MIN) {
+            value = INT16_MIN;
+        }
+        pcm[i] = value;
+    }
+    if (conversion->remove_dc_offset) {
+        const int32_t mean_q8 = (int32_t) ((sum << 8) / count);
+        conversion->dc_offset_q8 += (mean_q8 - conversion->dc_offset_q8) >> 3;
+    }
+}
+
+// Raw I2S words: the ADC channel in the top bits, a sample scattered around
+// centre in the low 12 bits, now and then at either rail.
+static void FillBlock(std::vector<uint16_t>* raw, int centre) {
+    for (size_t i = 0; i < raw->size(); ++i) {
+        int sample = centre + (int) (NextRandom() % 1024) - 512;
+        const uint32_t rail = NextRandom() % 64;
+        if (rail == 0) {
+            sample = 0;
+        } else if (rail == 1) {
+            sample = 0xfff;
+        }
+        (*raw)[i] = (uint16_t) ((6 << 12) | (sample & 0xfff));
+    }
+}
+
+static void CheckBlocks(bool remove_dc_offset, bool in_place) {
+    const int32_t gains[] = {1, 15, 16, 40};
+    for (int32_t gain : gains) {
+        AdcConversion conversion(gain, remove_dc_offset);
+        AdcConversion reference(gain, remove_dc_offset);
+        for (int block = 0; block < 400; ++block) {
+            // Every tail length after the 8-sample vectors, and blocks shorter than one.
+            const size_t count = (block < 40) ? block : 1 + (NextRandom() % 1100);
+            std::vector<uint16_t> raw(count);
+            FillBlock(&raw, 1500 + (block % 7) * 200);
+            std::vector<int16_t> expected(count);
+            ConvertReference(&reference, raw.data(), expected.data(), count);
+
+            std::vector<int16_t> pcm(count);
+            if (in_place) {
+                ConvertAdcSamples(&conversion, raw.data(), (int16_t*) raw.data(), count);
+                memcpy(pcm.data(), raw.data(), count * sizeof(int16_t));
+            } else {
+                ConvertAdcSamples(&conversion, raw.data(), pcm.data(), count);
+            }
+            if (count > 0) {
+                TEST_ASSERT_EQUAL_INT16_ARRAY(expected.data(), pcm.data(), count);
+            }
+            TEST_ASSERT_EQUAL_INT32(reference.dc_offset_q8, conversion.dc_offset_q8);
+        }
+    }
+}
+
+void setUp() {
+    random_state = 1;
+}
+
+void tearDown() {}
+
+static void test_fixed_offset_matches_reference() {
+    CheckBlocks(false, false);
+}
+
+static void test_dc_tracking_matches_reference() {
+    CheckBlocks(true, false);
+}
+
+static void test_in_place_matches_reference() {
+    CheckBlocks(true, true);
+}
+
+int main(int argc, char** argv) {
+    UNITY_BEGIN();
+    RUN_TEST(test_fixed_offset_matches_reference);
+    RUN_TEST(test_dc_tracking_matches_reference);
+    RUN_TEST(test_in_place_matches_reference);
+    return UNITY_END();
+}
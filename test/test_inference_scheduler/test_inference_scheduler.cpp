@@ -0,0 +1,73 @@
+// Checks which stride InferenceScheduler settles on for the scores it is given,
+// run on the host with pio test -e native.
+#include <unity.h>
+
+#include "InferenceScheduler.h"
+
+static const uint8_t kThreshold = 200;
+static const int kStableStrideSlices = 200 / kFeatureSliceStrideMs;
+
+// How many slices, added one at a time, until the scheduler asks for an invoke.
+static int SlicesUntilInvoke(InferenceScheduler* scheduler) {
+    for (int slices = 1; slices <= 100; ++slices) {
+        if (scheduler->ShouldInvoke(1)) {
+            return slices;
+        }
+    }
+    return -1;
+}
+
+// Feeds score after every invoke, as the app does, and returns the stride it ends on.
+static int StrideAfterScores(InferenceScheduler* scheduler, uint8_t score, bool is_new_level) {
+    for (int invoke = 0; invoke < 10; ++invoke) {
+        SlicesUntilInvoke(scheduler);
+        scheduler->UpdateResults(score, kThreshold, is_new_level);
+    }
+    return SlicesUntilInvoke(scheduler);
+}
+
+void setUp() {}
+
+void tearDown() {}
+
+static void test_starts_active_through_warm_up() {
+    InferenceScheduler scheduler;
+    TEST_ASSERT_EQUAL(1, StrideAfterScores(&scheduler, 0, false));
+}
+
+static void test_steady_detection_is_stable() {
+    InferenceScheduler scheduler;
+    TEST_ASSERT_EQUAL(1, StrideAfterScores(&scheduler, 250, true));
+    InferenceScheduler steady_scheduler;
+    TEST_ASSERT_EQUAL(kStableStrideSlices, StrideAfterScores(&steady_scheduler, 250, false));
+    TEST_ASSERT_EQUAL(kStableStrideSlices, StrideAfterScores(&steady_scheduler, 240, false));
+}
+
+static void test_nothing_detected_is_stable() {
+    InferenceScheduler scheduler;
+    TEST_ASSERT_EQUAL(kStableStrideSlices, StrideAfterScores(&scheduler, 120, false));
+}
+
+static void test_near_threshold_is_active() {
+    InferenceScheduler scheduler;
+    TEST_ASSERT_EQUAL(kStableStrideSlices, StrideAfterScores(&scheduler, 250, false));
+    TEST_ASSERT_EQUAL(1, StrideAfterScores(&scheduler, 210, false));
+    TEST_ASSERT_EQUAL(kStableStrideSlices, StrideAfterScores(&scheduler, 250, false));
+    TEST_ASSERT_EQUAL(1, StrideAfterScores(&scheduler, 185, false));
+}
+
+static void test_streaming_scores_every_slice() {
+    InferenceScheduler scheduler;
+    scheduler.ScoreEverySlice(true);
+    TEST_ASSERT_EQUAL(1, StrideAfterScores(&scheduler, 250, false));
+}
+
+int main(int argc, char** argv) {
+    UNITY_BEGIN();
+    RUN_TEST(test_starts_active_through_warm_up);
+    RUN_TEST(test_steady_detection_is_stable);
+    RUN_TEST(test_nothing_detected_is_stable);
+    RUN_TEST(test_near_threshold_is_active);
+    RUN_TEST(test_streaming_scores_every_slice);
+    return UNITY_END();
+}
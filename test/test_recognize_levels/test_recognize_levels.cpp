@@ -0,0 +1,245 @@
+// Checks RecognizeLevels against straightforward reference versions of its
+// averaging, run on the host with pio test -e native.
+#include <unity.h>
+
+#include <algorithm>
+#include <cmath>
+#include <deque>
+#include <limits>
+#include <stdint.h>
+
+#include "MicroModelSettings.h"
+#include "RecognizeLevels.h"
+
+static const int32_t kWindowMs = 1000;
+static const uint8_t kThreshold = 200;
+static const int32_t kSuppressionMs = 1500;
+static const int32_t kMinimumCount = 5;
+
+static tflite::MicroErrorReporter error_reporter;
+static uint32_t random_state = 1;
+
+static int32_t RandomBetween(int32_t low, int32_t high) {
+    random_state = (random_state * 1103515245u) + 12345u;
+    return low + (int32_t) ((random_state >> 8) % (uint32_t) (high - low + 1));
+}
+
+// A results tensor as the model's output would be, [1, kCategoryCount] of int8.
+struct Results {
+    Results(float scale, int32_t zero_point) : tensor() {
+        dims_data[0] = 2;
+        dims_data[1] = 1;
+        dims_data[2] = kCategoryCount;
+        tensor.type = kTfLiteInt8;
+        tensor.dims = reinterpret_cast<TfLiteIntArray*>(dims_data);
+        tensor.params.scale = scale;
+        tensor.params.zero_point = zero_point;
+        tensor.data.int8 = scores;
+    }
+    int dims_data[3];
+    int8_t scores[kCategoryCount];
+    TfLiteTensor tensor;
+};
+
+struct TimedScores {
+    int64_t time;
+    int8_t scores[kCategoryCount];
+};
+
+// The results in the averaging window, kept the plain way.
+static void AddToWindow(std::deque<TimedScores>* window, int64_t time, const int8_t* scores) {
+    TimedScores entry;
+    entry.time = time;
+    std::copy(scores, scores + kCategoryCount, entry.scores);
+    window->push_back(entry);
+    while (window->front().time < time - kWindowMs) {
+        window->pop_front();
+    }
+}
+
+static bool WindowIsReliable(const std::deque<TimedScores>& window, int64_t time) {
+    return ((int32_t) window.size() >= kMinimumCount) &&
+        (time - window.front().time >= kWindowMs / 4);
+}
+
+void setUp() {
+    random_state = 1;
+}
+
+void tearDown() {}
+
+// Softmax outputs are averaged as they always were, with the sums recomputed
+// from the whole window for every result.
+static void test_softmax_output_matches_reference() {
+    RecognizeLevels recognizer(&error_reporter, kWindowMs, kThreshold, kSuppressionMs, kMinimumCount);
+    Results results(1.0f / 256, -128);
+    std::deque<TimedScores> window;
+    PowerLevel previous_label = PowerLevel::NONE;
+    int64_t previous_label_time = std::numeric_limits<int64_t>::min();
+    int new_levels = 0;
+    int dominant = 0;
+
+    for (int step = 0; step < 20000; ++step) {
+        const int64_t time = (step * 100) + ((step % 3) * 17);
+        // Levels that last a few seconds, with results now and then pointing elsewhere.
+        if (RandomBetween(0, 29) == 0) {
+            dominant = RandomBetween(0, kCategoryCount - 1);
+        }
+        const int pointing_at = (RandomBetween(0, 3) == 0) ? RandomBetween(0, kCategoryCount - 1) : dominant;
+        for (int i = 0; i < kCategoryCount; ++i) {
+            results.scores[i] = (int8_t) ((i == pointing_at) ? RandomBetween(40, 127) : RandomBetween(-128, -60));
+        }
+        PowerLevel level;
+        uint8_t score;
+        bool is_new_level;
+        TEST_ASSERT_EQUAL(kTfLiteOk, recognizer.ProcessLatestResults(&results.tensor, time, &level,
+                                                                     &score, &is_new_level));
+
+        AddToWindow(&window, time, results.scores);
+        PowerLevel expected_level = previous_label;
+        int32_t expected_score = 0;
+        bool expected_new = false;
+        if (WindowIsReliable(window, time)) {
+            const int32_t count = window.size();
+            int top = 0;
+            for (int i = 0; i < kCategoryCount; ++i) {
+                int32_t sum = 0;
+                for (const TimedScores& entry : window) {
+                    sum += entry.scores[i] + 128;
+                }
+                if (sum / count > expected_score) {
+                    expected_score = sum / count;
+                    top = i;
+                }
+            }
+            expected_level = kCategoryLabels[top];
+            const bool is_suppressed = (previous_label != kCategoryLabels[0]) &&
+                (previous_label_time != std::numeric_limits<int64_t>::min()) &&
+                (time - previous_label_time <= kSuppressionMs);
+            expected_new = (expected_score > kThreshold) &&
+                ((expected_level != previous_label) || !is_suppressed);
+            if (expected_new) {
+                previous_label = expected_level;
+                previous_label_time = time;
+                ++new_levels;
+            }
+        }
+        TEST_ASSERT_EQUAL(expected_level, level);
+        TEST_ASSERT_EQUAL(expected_score, score);
+        TEST_ASSERT_EQUAL(expected_new, is_new_level);
+    }
+    TEST_ASSERT_TRUE(new_levels > 100);
+}
+
+// Logits are thresholded on the top level's margin over the runner-up, and a
+// reported level is scored with the softmax of the averaged logits. Both are
+// compared to double precision, for a range of output quantizations.
+static void test_logits_output_matches_reference() {
+    int reported = 0;
+    for (int trial = 0; trial < 200; ++trial) {
+        const float scale = RandomBetween(20, 500) / 1000.0f;
+        const int32_t zero_point = RandomBetween(-30, 30);
+        RecognizeLevels recognizer(&error_reporter, kWindowMs, kThreshold, kSuppressionMs, kMinimumCount);
+        Results results(scale, zero_point);
+        std::deque<TimedScores> window;
+
+        for (int step = 0; step < 40; ++step) {
+            const int64_t time = step * 100;
+            const int dominant = RandomBetween(0, kCategoryCount - 1);
+            for (int i = 0; i < kCategoryCount; ++i) {
+                const int32_t logit = RandomBetween(-60, 60) + ((i == dominant) ? 50 : 0);
+                results.scores[i] = (int8_t) std::max(-128, std::min(127, logit));
+            }
+            PowerLevel level;
+            uint8_t score;
+            bool is_new_level;
+            TEST_ASSERT_EQUAL(kTfLiteOk, recognizer.ProcessLatestResults(&results.tensor, time, &level,
+                                                                         &score, &is_new_level));
+
+            AddToWindow(&window, time, results.scores);
+            if (!WindowIsReliable(window, time)) {
+                TEST_ASSERT_FALSE(is_new_level);
+                continue;
+            }
+            double averages[kCategoryCount] = {};
+            int32_t sums[kCategoryCount] = {};
+            for (const TimedScores& entry : window) {
+                for (int i = 0; i < kCategoryCount; ++i) {
+                    averages[i] += (entry.scores[i] - zero_point) * scale / window.size();
+                    sums[i] += entry.scores[i];
+                }
+            }
+            int top = 0;
+            for (int i = 1; i < kCategoryCount; ++i) {
+                if (sums[i] > sums[top]) {
+                    top = i;
+                }
+            }
+            TEST_ASSERT_EQUAL(kCategoryLabels[top], level);
+
+            double runner_up = -1e9;
+            double exp_sum = 0;
+            for (int i = 0; i < kCategoryCount; ++i) {
+                if (i != top) {
+                    runner_up = std::max(runner_up, averages[i]);
+                }
+                exp_sum += exp(averages[i] - averages[top]);
+            }
+            const int32_t two_level_score = std::min(255L, lround(256 / (1 + exp(runner_up - averages[top]))));
+            if (is_new_level) {
+                ++reported;
+                TEST_ASSERT_INT_WITHIN(5, std::min(255L, lround(256 / exp_sum)), score);
+                TEST_ASSERT_TRUE(two_level_score > kThreshold - 5);
+            } else {
+                TEST_ASSERT_INT_WITHIN(5, two_level_score, score);
+            }
+        }
+    }
+    TEST_ASSERT_TRUE(reported > 100);
+}
+
+// After Reset(), as on a model switch, a recognizer that was fed softmax outputs
+// scores a logits model's results exactly like a new one does.
+static void test_reset_forgets_the_previous_model() {
+    RecognizeLevels recognizer(&error_reporter, kWindowMs, kThreshold, kSuppressionMs, kMinimumCount);
+    RecognizeLevels fresh(&error_reporter, kWindowMs, kThreshold, kSuppressionMs, kMinimumCount);
+    Results softmax(1.0f / 256, -128);
+    Results logits(0.1f, 4);
+    PowerLevel level;
+    uint8_t score;
+    bool is_new_level;
+
+    // A confidently detected level from the softmax model.
+    for (int step = 0; step < 20; ++step) {
+        for (int i = 0; i < kCategoryCount; ++i) {
+            softmax.scores[i] = (i == 2) ? 127 : -128;
+        }
+        recognizer.ProcessLatestResults(&softmax.tensor, step * 100, &level, &score, &is_new_level);
+    }
+    TEST_ASSERT_EQUAL(kCategoryLabels[2], level);
+    recognizer.Reset();
+
+    for (int step = 20; step < 60; ++step) {
+        for (int i = 0; i < kCategoryCount; ++i) {
+            logits.scores[i] = (int8_t) RandomBetween(-40, 40) + ((i == 2) ? 30 : 0);
+        }
+        PowerLevel fresh_level;
+        uint8_t fresh_score;
+        bool fresh_is_new_level;
+        TEST_ASSERT_EQUAL(kTfLiteOk, recognizer.ProcessLatestResults(&logits.tensor, step * 100, &level,
+                                                                     &score, &is_new_level));
+        fresh.ProcessLatestResults(&logits.tensor, step * 100, &fresh_level, &fresh_score,
+                                   &fresh_is_new_level);
+        TEST_ASSERT_EQUAL(fresh_level, level);
+        TEST_ASSERT_EQUAL(fresh_score, score);
+        TEST_ASSERT_EQUAL(fresh_is_new_level, is_new_level);
+    }
+}
+
+int main(int argc, char** argv) {
+    UNITY_BEGIN();
+    RUN_TEST(test_softmax_output_matches_reference);
+    RUN_TEST(test_logits_output_matches_reference);
+    RUN_TEST(test_reset_forgets_the_previous_model);
+    return UNITY_END();
+}
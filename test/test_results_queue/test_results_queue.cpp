@@ -0,0 +1,123 @@
+// Checks PreviousResultsQueue and its running sums against a plain copy of what
+// it should hold, run on the host with pio test -e native.
+#include <unity.h>
+
+#include <deque>
+#include <stdint.h>
+
+#include "RecognizeLevels.h"
+
+static const int kMaxResults = 7;
+
+static tflite::MicroErrorReporter error_reporter;
+static uint32_t random_state = 1;
+
+static int32_t RandomBetween(int32_t low, int32_t high) {
+    random_state = (random_state * 1103515245u) + 12345u;
+    return low + (int32_t) ((random_state >> 8) % (uint32_t) (high - low + 1));
+}
+
+static PreviousResultsQueue::Result RandomResult(int64_t time) {
+    int8_t scores[kCategoryCount];
+    for (int i = 0; i < kCategoryCount; ++i) {
+        scores[i] = (int8_t) RandomBetween(-128, 127);
+    }
+    return PreviousResultsQueue::Result(time, scores);
+}
+
+static void CheckMatches(PreviousResultsQueue* queue,
+                         const std::deque<PreviousResultsQueue::Result>& expected) {
+    TEST_ASSERT_EQUAL((int) expected.size(), queue->size());
+    int32_t sums[kCategoryCount] = {};
+    for (size_t i = 0; i < expected.size(); ++i) {
+        TEST_ASSERT_EQUAL(expected[i].time_, queue->from_front(i).time_);
+        for (int j = 0; j < kCategoryCount; ++j) {
+            sums[j] += expected[i].scores[j];
+        }
+    }
+    if (!expected.empty()) {
+        TEST_ASSERT_EQUAL(expected.front().time_, queue->front().time_);
+        TEST_ASSERT_EQUAL(expected.back().time_, queue->back().time_);
+    }
+    for (int j = 0; j < kCategoryCount; ++j) {
+        TEST_ASSERT_EQUAL_INT32(sums[j], queue->sums()[j]);
+    }
+}
+
+void setUp() {
+    random_state = 1;
+}
+
+void tearDown() {}
+
+// Pushes and pops at random, so the queue wraps around its storage many times,
+// without ever filling up.
+static void test_sums_follow_pushes_and_pops() {
+    PreviousResultsQueue queue(&error_reporter, kMaxResults);
+    std::deque<PreviousResultsQueue::Result> expected;
+    for (int step = 0; step < 20000; ++step) {
+        const bool push = expected.empty() ||
+            (((int) expected.size() < kMaxResults) && (RandomBetween(0, 1) == 0));
+        if (push) {
+            const PreviousResultsQueue::Result result = RandomResult(step);
+            queue.push_back(result);
+            expected.push_back(result);
+        } else {
+            const PreviousResultsQueue::Result popped = queue.pop_front();
+            TEST_ASSERT_EQUAL(expected.front().time_, popped.time_);
+            expected.pop_front();
+        }
+        CheckMatches(&queue, expected);
+    }
+}
+
+// Pushing onto a full queue drops the oldest result, and its scores from the sums.
+static void test_full_queue_evicts_the_oldest() {
+    PreviousResultsQueue queue(&error_reporter, kMaxResults);
+    std::deque<PreviousResultsQueue::Result> expected;
+    for (int step = 0; step < 3 * kMaxResults + 2; ++step) {
+        const PreviousResultsQueue::Result result = RandomResult(step);
+        queue.push_back(result);
+        expected.push_back(result);
+        if ((int) expected.size() > kMaxResults) {
+            expected.pop_front();
+        }
+        CheckMatches(&queue, expected);
+    }
+    TEST_ASSERT_EQUAL(kMaxResults, queue.size());
+    TEST_ASSERT_EQUAL(2 * kMaxResults + 2, queue.front().time_);
+}
+
+static void test_pop_from_empty_queue_keeps_it_empty() {
+    PreviousResultsQueue queue(&error_reporter, kMaxResults);
+    queue.pop_front();
+    TEST_ASSERT_TRUE(queue.empty());
+    for (int j = 0; j < kCategoryCount; ++j) {
+        TEST_ASSERT_EQUAL_INT32(0, queue.sums()[j]);
+    }
+}
+
+static void test_clear_empties_queue_and_sums() {
+    PreviousResultsQueue queue(&error_reporter, kMaxResults);
+    std::deque<PreviousResultsQueue::Result> expected;
+    for (int step = 0; step < kMaxResults + 3; ++step) {
+        queue.push_back(RandomResult(step));
+    }
+    queue.clear();
+    CheckMatches(&queue, expected);
+    for (int step = 0; step < 3; ++step) {
+        const PreviousResultsQueue::Result result = RandomResult(step);
+        queue.push_back(result);
+        expected.push_back(result);
+    }
+    CheckMatches(&queue, expected);
+}
+
+int main(int argc, char** argv) {
+    UNITY_BEGIN();
+    RUN_TEST(test_sums_follow_pushes_and_pops);
+    RUN_TEST(test_full_queue_evicts_the_oldest);
+    RUN_TEST(test_pop_from_empty_queue_keeps_it_empty);
+    RUN_TEST(test_clear_empties_queue_and_sums);
+    return UNITY_END();
+}
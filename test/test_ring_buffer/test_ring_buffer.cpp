@@ -0,0 +1,142 @@
+// Two thread stress tests for the ring buffer, run on the host with
+// pio test -e native. The writer streams a pseudo random byte sequence in random
+// sized chunks and the reader checks every byte arrives once and in order, across
+// many wraparounds of the buffer and of the free running head and tail counts.
+#include <unity.h>
+
+#include <stdint.h>
+#include <thread>
+
+#include "RingBuffer.h"
+
+static const uint32_t kRingSize = 1024;
+static const int kStreamBytes = 8 * 1024 * 1024;
+static const int kMaxChunk = 700;
+
+static ringbuf_t* ring = NULL;
+
+// A byte sequence either side can regenerate from its position alone.
+static uint8_t StreamByte(uint32_t position) {
+    uint32_t x = position * 2654435761u;
+    return (uint8_t)((x >> 24) ^ (x >> 13) ^ position);
+}
+
+// Chunk sizes, different on each side so the reads and writes don't line up.
+static int ChunkLength(uint32_t* state) {
+    *state = (*state * 1103515245u) + 12345u;
+    return 1 + (int)((*state >> 16) % kMaxChunk);
+}
+
+static void WriteStream() {
+    uint8_t chunk[kMaxChunk];
+    uint32_t random = 1;
+    int written = 0;
+    while (written < kStreamBytes) {
+        int len = ChunkLength(&random);
+        if (len > kStreamBytes - written) {
+            len = kStreamBytes - written;
+        }
+        for (int i = 0; i < len; ++i) {
+            chunk[i] = StreamByte(written + i);
+        }
+        if (rb_write(ring, chunk, len, portMAX_DELAY) != len) {
+            return;
+        }
+        written += len;
+    }
+}
+
+void setUp() {
+    ring = rb_init("test", kRingSize);
+    // Start just short of the 32-bit wrap of the free running counts, so the
+    // stream runs across it.
+    ring->head = ring->tail = ring->write_reserve = 0xFFFFF000u;
+}
+
+void tearDown() {
+    rb_cleanup(ring);
+    ring = NULL;
+}
+
+static void test_read_keeps_order_across_wraparound() {
+    std::thread writer(WriteStream);
+    uint8_t chunk[kMaxChunk];
+    uint32_t random = 7;
+    int read = 0;
+    int mismatches = 0;
+    while (read < kStreamBytes) {
+        int len = ChunkLength(&random);
+        if (len > kStreamBytes - read) {
+            len = kStreamBytes - read;
+        }
+        int got = rb_read(ring, chunk, len, portMAX_DELAY);
+        if (got != len) {
+            break;
+        }
+        for (int i = 0; i < got; ++i) {
+            mismatches += chunk[i] != StreamByte(read + i);
+        }
+        read += got;
+    }
+    writer.join();
+    TEST_ASSERT_EQUAL(kStreamBytes, read);
+    TEST_ASSERT_EQUAL(0, mismatches);
+    TEST_ASSERT_EQUAL(0, rb_filled(ring));
+}
+
+static void test_peek_keeps_order_across_wraparound() {
+    std::thread writer(WriteStream);
+    uint32_t random = 7;
+    int read = 0;
+    int mismatches = 0;
+    while (read < kStreamBytes) {
+        int len = ChunkLength(&random);
+        if (len > kStreamBytes - read) {
+            len = kStreamBytes - read;
+        }
+        uint8_t *ptr1, *ptr2;
+        int len1, len2;
+        int got = rb_peek(ring, &ptr1, &len1, &ptr2, &len2, len, portMAX_DELAY);
+        if ((got != len) || (len1 + len2 != got)) {
+            break;
+        }
+        for (int i = 0; i < len1; ++i) {
+            mismatches += ptr1[i] != StreamByte(read + i);
+        }
+        for (int i = 0; i < len2; ++i) {
+            mismatches += ptr2[i] != StreamByte(read + len1 + i);
+        }
+        rb_commit_read(ring, got);
+        read += got;
+    }
+    writer.join();
+    TEST_ASSERT_EQUAL(kStreamBytes, read);
+    TEST_ASSERT_EQUAL(0, mismatches);
+    TEST_ASSERT_EQUAL(0, rb_filled(ring));
+}
+
+static void test_commit_read_rejects_more_than_filled() {
+    uint8_t data[100];
+    for (int i = 0; i < 100; ++i) {
+        data[i] = StreamByte(i);
+    }
+    TEST_ASSERT_EQUAL(100, rb_write(ring, data, 100, 0));
+    TEST_ASSERT_EQUAL(RB_FAIL, rb_commit_read(ring, 101));
+    TEST_ASSERT_EQUAL(RB_FAIL, rb_commit_read(ring, -1));
+    TEST_ASSERT_EQUAL(100, rb_filled(ring));
+    TEST_ASSERT_EQUAL(40, rb_commit_read(ring, 40));
+    TEST_ASSERT_EQUAL(60, rb_filled(ring));
+    uint8_t rest[60];
+    TEST_ASSERT_EQUAL(60, rb_read(ring, rest, 60, 0));
+    TEST_ASSERT_EQUAL_MEMORY(data + 40, rest, 60);
+    TEST_ASSERT_EQUAL(RB_FAIL, rb_commit_read(ring, 1));
+    TEST_ASSERT_EQUAL(0, rb_filled(ring));
+}
+
+int main(int argc, char** argv) {
+    UNITY_BEGIN();
+    RUN_TEST(test_read_keeps_order_across_wraparound);
+    RUN_TEST(test_peek_keeps_order_across_wraparound);
+    RUN_TEST(test_commit_read_rejects_more_than_filled);
+    return UNITY_END();
+}
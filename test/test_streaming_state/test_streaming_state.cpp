@@ -0,0 +1,168 @@
+// Checks that StreamingState carries a streaming model's state from one invoke to
+// the next, run on the host with pio test -e native. A stand-in model with two
+// states runs over tensors laid out in one arena the way a memory planner might,
+// and is compared with the same model keeping its state in buffers of its own.
+#include <unity.h>
+
+#include <stdint.h>
+#include <string.h>
+
+#include "StreamingState.h"
+
+static const int kFeatureBytes = 40;
+static const int kStateABytes = 96;
+static const int kStateBBytes = 48;
+
+static tflite::MicroErrorReporter error_reporter;
+
+static uint32_t random_state = 1;
+
+static int8_t RandomByte() {
+    random_state = (random_state * 1103515245u) + 12345u;
+    return (int8_t) (random_state >> 16);
+}
+
+static void SetUpTensor(TfLiteTensor* tensor, int8_t* data, int bytes, float scale, int32_t zero_point) {
+    memset(tensor, 0, sizeof(*tensor));
+    tensor->type = kTfLiteInt8;
+    tensor->data.int8 = data;
+    tensor->bytes = bytes;
+    tensor->params.scale = scale;
+    tensor->params.zero_point = zero_point;
+}
+
+// The stand-in model. State A keeps the newest slices, shifted along by one each
+// invoke, and state B a running mix of A's oldest bytes. The score depends on both.
+struct StandInModel {
+    TfLiteTensor feature_input;
+    TfLiteTensor state_a_input;
+    TfLiteTensor state_b_input;
+    TfLiteTensor score_output;
+    TfLiteTensor state_a_output;
+    TfLiteTensor state_b_output;
+
+    void Invoke() {
+        // Everything is read before any output is written, as the planner only lets an
+        // output reuse an input's memory once nothing reads the input any more.
+        int8_t next_a[kStateABytes];
+        int8_t next_b[kStateBBytes];
+        memcpy(next_a, state_a_input.data.int8 + kFeatureBytes, kStateABytes - kFeatureBytes);
+        memcpy(next_a + kStateABytes - kFeatureBytes, feature_input.data.int8, kFeatureBytes);
+        int32_t score = 0;
+        for (int i = 0; i < kStateBBytes; ++i) {
+            next_b[i] = (int8_t) ((state_b_input.data.int8[i] * 3) + state_a_input.data.int8[i] + 1);
+            score += state_b_input.data.int8[i] * (i + 1);
+        }
+        for (int i = 0; i < kStateABytes; ++i) {
+            score += state_a_input.data.int8[i] * (i % 5);
+        }
+        memcpy(state_a_output.data.int8, next_a, kStateABytes);
+        memcpy(state_b_output.data.int8, next_b, kStateBBytes);
+        score_output.data.int8[0] = (int8_t) score;
+        score_output.data.int8[1] = (int8_t) (score >> 8);
+    }
+};
+
+// Lays the tensors out in arena, with the state outputs either apart from the
+// state inputs or each over the other state's input, and the outputs listed in a
+// different order than the inputs.
+static void SetUpModel(StandInModel* model, int8_t* arena, bool overlapping,
+                       TfLiteTensor** inputs, const TfLiteTensor** outputs) {
+    SetUpTensor(&model->feature_input, arena, kFeatureBytes, 0.1f, -128);
+    SetUpTensor(&model->state_a_input, arena + 64, kStateABytes, 0.5f, 3);
+    SetUpTensor(&model->state_b_input, arena + 64 + kStateABytes, kStateBBytes, 0.25f, -2);
+    SetUpTensor(&model->score_output, arena + 512, 2, 1.0f / 256, -128);
+    if (overlapping) {
+        // A's output starts over B's input, and B's output is over the start of A's.
+        SetUpTensor(&model->state_a_output, arena + 64 + kStateABytes, kStateABytes, 0.5f, 3);
+        SetUpTensor(&model->state_b_output, arena + 64, kStateBBytes, 0.25f, -2);
+    } else {
+        SetUpTensor(&model->state_a_output, arena + 256, kStateABytes, 0.5f, 3);
+        SetUpTensor(&model->state_b_output, arena + 384, kStateBBytes, 0.25f, -2);
+    }
+    inputs[0] = &model->state_b_input;
+    inputs[1] = &model->feature_input;
+    inputs[2] = &model->state_a_input;
+    outputs[0] = &model->state_a_output;
+    outputs[1] = &model->score_output;
+    outputs[2] = &model->state_b_output;
+}
+
+static void CheckCarriedState(bool overlapping) {
+    int8_t arena[1024] = {};
+    StandInModel model;
+    TfLiteTensor* inputs[3];
+    const TfLiteTensor* outputs[3];
+    SetUpModel(&model, arena, overlapping, inputs, outputs);
+
+    int8_t reference_arena[1024] = {};
+    StandInModel reference;
+    TfLiteTensor* reference_inputs[3];
+    const TfLiteTensor* reference_outputs[3];
+    SetUpModel(&reference, reference_arena, false, reference_inputs, reference_outputs);
+
+    StreamingState state;
+    TEST_ASSERT_EQUAL(kTfLiteOk, state.Initialize(&error_reporter, inputs, 3, outputs, 3, 1, 1));
+    TEST_ASSERT_EQUAL(2, state.StateCount());
+    TEST_ASSERT_EQUAL(overlapping, state.IsStaged());
+    // The state starts out at the zero points.
+    for (int i = 0; i < kStateABytes; ++i) {
+        TEST_ASSERT_EQUAL_INT8(3, model.state_a_input.data.int8[i]);
+    }
+    for (int i = 0; i < kStateBBytes; ++i) {
+        TEST_ASSERT_EQUAL_INT8(-2, model.state_b_input.data.int8[i]);
+    }
+    memset(reference.state_a_input.data.int8, 3, kStateABytes);
+    memset(reference.state_b_input.data.int8, -2, kStateBBytes);
+
+    for (int invoke = 0; invoke < 500; ++invoke) {
+        for (int i = 0; i < kFeatureBytes; ++i) {
+            model.feature_input.data.int8[i] = reference.feature_input.data.int8[i] = RandomByte();
+        }
+        model.Invoke();
+        reference.Invoke();
+        TEST_ASSERT_EQUAL_MEMORY(reference.score_output.data.int8, model.score_output.data.int8, 2);
+        state.Carry();
+        // The reference's outputs are apart from its inputs, so a plain copy is right.
+        memcpy(reference.state_a_input.data.int8, reference.state_a_output.data.int8, kStateABytes);
+        memcpy(reference.state_b_input.data.int8, reference.state_b_output.data.int8, kStateBBytes);
+        TEST_ASSERT_EQUAL_MEMORY(reference.state_a_input.data.int8, model.state_a_input.data.int8,
+                                 kStateABytes);
+        TEST_ASSERT_EQUAL_MEMORY(reference.state_b_input.data.int8, model.state_b_input.data.int8,
+                                 kStateBBytes);
+    }
+}
+
+void setUp() {
+    random_state = 1;
+}
+
+void tearDown() {}
+
+static void test_carries_state_to_its_own_input() {
+    CheckCarriedState(false);
+}
+
+static void test_carries_state_through_staging_when_outputs_overlap_inputs() {
+    CheckCarriedState(true);
+}
+
+static void test_rejects_state_without_matching_output() {
+    int8_t arena[1024] = {};
+    StandInModel model;
+    TfLiteTensor* inputs[3];
+    const TfLiteTensor* outputs[3];
+    SetUpModel(&model, arena, false, inputs, outputs);
+    model.state_b_output.params.zero_point = 0;
+
+    StreamingState state;
+    TEST_ASSERT_EQUAL(kTfLiteError, state.Initialize(&error_reporter, inputs, 3, outputs, 3, 1, 1));
+}
+
+int main(int argc, char** argv) {
+    UNITY_BEGIN();
+    RUN_TEST(test_carries_state_to_its_own_input);
+    RUN_TEST(test_carries_state_through_staging_when_outputs_overlap_inputs);
+    RUN_TEST(test_rejects_state_without_matching_output);
+    return UNITY_END();
+}